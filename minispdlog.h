@@ -13,10 +13,21 @@
 #ifndef _MINISDPLOG_H
 #define _MINISDPLOG_H
 
+#include <algorithm>
 #include <atomic>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <csignal>
 #include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -25,22 +36,3177 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
+
+/* Platform detection */
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#define MINISPDLOG_POSIX
+#endif
+
+#ifdef MINISPDLOG_POSIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 namespace MiniLogger {
 
-// Configuration constants - centralized for easy maintenance
-namespace Config {
-    static const int THREAD_ID_MODULO = 10000;
-    static const int TIMESTAMP_PRECISION = 6;
-    static const char* TIMESTAMP_FORMAT = "%Y-%m-%d %H:%M:%S";
-}
+// Configuration constants - centralized for easy maintenance
+namespace Config {
+    static const int THREAD_ID_MODULO = 10000;
+    static const int TIMESTAMP_PRECISION = 6;
+    static const char* TIMESTAMP_FORMAT = "%Y-%m-%d %H:%M:%S";
+}
+
+enum class LogLevel {
+    DEBUG = 0,
+    INFO,
+    WARN,
+    ERROR,
+    CRITICAL,
+};
+
+inline const char *level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::DEBUG:
+        return "DEBUG";
+    case LogLevel::INFO:
+        return "INFO";
+    case LogLevel::WARN:
+        return "WARN";
+    case LogLevel::ERROR:
+        return "ERROR";
+    case LogLevel::CRITICAL:
+        return "CRITICAL";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+/**
+ * Parse a level name, case insensitive
+ * Returns false, leaving `level` untouched, for unknown names.
+ */
+inline bool level_from_string(const std::string &name, LogLevel &level) {
+    std::string upper(name);
+    std::transform(upper.begin(), upper.end(), upper.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    for (int i = 0; i <= static_cast<int>(LogLevel::CRITICAL); ++i) {
+        if (upper == level_name(static_cast<LogLevel>(i))) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    if (upper == "WARNING") {
+        level = LogLevel::WARN;
+        return true;
+    }
+    return false;
+}
+
+#ifdef MINISPDLOG_POSIX
+/**
+ * socket(2) and pipe(2) with close-on-exec set atomically where the system
+ * supports it, so that a child forked by another thread meanwhile does not
+ * inherit the descriptors
+ */
+inline int cloexec_socket(int domain, int type) {
+#ifdef SOCK_CLOEXEC
+    return ::socket(domain, type | SOCK_CLOEXEC, 0);
+#else
+    int fd = ::socket(domain, type, 0);
+    if (fd >= 0) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+inline int cloexec_pipe(int fds[2]) {
+#ifdef __linux__
+    return ::pipe2(fds, O_CLOEXEC);
+#else
+    if (::pipe(fds) != 0) {
+        return -1;
+    }
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+#endif
+}
+#endif // MINISPDLOG_POSIX
+
+/**
+ * One entry of a thread's mapped diagnostic context (MDC)
+ * Blocks are immutable once pushed and form a stack through `parent`.
+ * `rendered` holds the text of the whole stack, " [key=value ...]", built
+ * once at push time so that formatting a record only appends it. Records
+ * keep a reference to the top block, which keeps the stack alive.
+ */
+struct ContextBlock {
+    std::shared_ptr<const ContextBlock> parent;
+    std::string key;
+    std::string value;
+    std::string rendered;
+};
+
+/**
+ * A single log record as it is handed to sinks
+ * The entry is the fully formatted line, without the trailing newline.
+ */
+struct LogRecord {
+    LogRecord() : level(LogLevel::DEBUG) {}
+    LogRecord(LogLevel level, std::string entry)
+        : level(level), entry(std::move(entry)) {}
+
+    LogLevel level;
+    std::string entry;
+    uint64_t seq = 0;     // position in the async queue, 0 in sync mode
+    bool durable = false; // requested through Logger::log_durable()
+
+    // Timing span recorded by SLOG_SCOPE; only delivered to sinks that
+    // accept spans, and never written to the log file
+    const char *span_name = nullptr;
+    int64_t span_start_us = 0;
+    int64_t span_duration_us = 0;
+    size_t thread_id = 0;
+
+    // Raw parts of the entry, captured by the logging thread; in async mode
+    // the entry itself is formatted by the worker
+    std::string message;
+    std::chrono::system_clock::time_point time;
+    std::shared_ptr<const ContextBlock> context;
+};
+
+/**
+ * Access to the calling thread's context stack
+ */
+class LogContext {
+  public:
+    static std::shared_ptr<const ContextBlock> &current() {
+        static thread_local std::shared_ptr<const ContextBlock> top;
+        return top;
+    }
+
+    /**
+     * Build the block for a key/value pair on top of `parent`
+     */
+    static std::shared_ptr<const ContextBlock>
+    make_block(std::shared_ptr<const ContextBlock> parent,
+               const std::string &key, std::string value) {
+        auto block = std::make_shared<ContextBlock>();
+        block->rendered =
+            parent ? parent->rendered.substr(0, parent->rendered.size() - 1) + ' '
+                   : std::string(" [");
+        block->rendered += key + '=' + value + ']';
+        block->parent = std::move(parent);
+        block->key = key;
+        block->value = std::move(value);
+        return block;
+    }
+};
+
+/**
+ * RAII push of a key/value pair on the thread's context stack
+ * Every record logged by the thread while the object is alive carries the
+ * pair, e.g. "... [Thread:42] [request_id=abc user=7] message". Scopes must
+ * be nested, as automatic variables naturally are.
+ */
+class ScopedContext {
+  public:
+    template <typename T>
+    ScopedContext(const std::string &key, const T &value)
+        : saved_(LogContext::current()) {
+        std::ostringstream ss;
+        ss << value;
+        LogContext::current() = LogContext::make_block(saved_, key, ss.str());
+    }
+
+    ~ScopedContext() { LogContext::current() = std::move(saved_); }
+
+    ScopedContext(const ScopedContext &) = delete;
+    ScopedContext &operator=(const ScopedContext &) = delete;
+
+  private:
+    std::shared_ptr<const ContextBlock> saved_;
+};
+
+/**
+ * Append-only log file
+ * On POSIX systems a raw descriptor opened with O_APPEND | O_CLOEXEC, and
+ * each write() is a single writev(2): lines written together are never
+ * split or interleaved with those of other processes appending to the same
+ * file, and no locale or streambuf machinery sits in the way. Elsewhere a
+ * std::ofstream is used instead.
+ *
+ * Two options keep large logs cheap. drop_cache() drops written pages from
+ * the page cache (posix_fadvise DONTNEED) one window behind the end, so
+ * logging does not evict the application's data; on Linux each window is
+ * handed to writeback with sync_file_range() as soon as it is complete, and
+ * waited for before being dropped. preallocate() (Linux only) allocates the
+ * file ahead in extents without changing its size, which spares metadata
+ * updates and fragmentation; the unused tail is trimmed on close, so it is
+ * meant for files with a single writer.
+ */
+class LogFile {
+  public:
+    LogFile() {}
+    ~LogFile() { close(); }
+
+    LogFile(const LogFile &) = delete;
+    LogFile &operator=(const LogFile &) = delete;
+
+    bool open(const std::string &filename) {
+        close();
+#ifdef MINISPDLOG_POSIX
+        fd_ = ::open(filename.c_str(),
+                     O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        failed_ = fd_ < 0;
+        struct stat st;
+        start_ = fd_ >= 0 && ::fstat(fd_, &st) == 0
+                     ? static_cast<uint64_t>(st.st_size)
+                     : 0;
+        written_ = retry_allocate_ = 0;
+        dropped_to_ = started_to_ = allocated_to_ = start_;
+        next_drop_ = drop_cache_bytes_;
+        return fd_ >= 0;
+#else
+        file_.open(filename, std::ios::binary | std::ios::app);
+        return file_.is_open();
+#endif
+    }
+
+    bool is_open() const {
+#ifdef MINISPDLOG_POSIX
+        return fd_ >= 0;
+#else
+        return file_.is_open();
+#endif
+    }
+
+    /**
+     * Close the file, giving back the preallocated space past its end
+     */
+    void close() {
+#ifdef MINISPDLOG_POSIX
+        if (fd_ >= 0) {
+            struct stat st;
+            if (allocated_to_ > start_ + written_ && ::fstat(fd_, &st) == 0 &&
+                static_cast<uint64_t>(st.st_size) < allocated_to_) {
+                // Blocks past the end are only released by a truncation
+                (void)::ftruncate(fd_, st.st_size);
+            }
+            ::close(fd_);
+            fd_ = -1;
+        }
+#else
+        file_.close();
+#endif
+    }
+
+    /**
+     * Append `data`, followed by a newline if asked, in one write
+     * Returns false, and the file stops being good(), on an error.
+     */
+    bool write(const char *data, size_t size, bool newline = false) {
+#ifdef MINISPDLOG_POSIX
+        struct iovec iov[2];
+        iov[0].iov_base = const_cast<char *>(data);
+        iov[0].iov_len = size;
+        iov[1].iov_base = const_cast<char *>("\n");
+        iov[1].iov_len = newline ? 1 : 0;
+        return write_iov(iov, newline ? 2 : 1, size + (newline ? 1 : 0));
+#else
+        file_.write(data, static_cast<std::streamsize>(size));
+        if (newline) {
+            file_.put('\n');
+        }
+        file_.flush();
+        return static_cast<bool>(file_);
+#endif
+    }
+
+    /**
+     * Append `count` lines, each followed by a newline, in one write
+     * Longer batches than the system takes in one writev(2) are written
+     * in chunks.
+     */
+    bool write_lines(const std::string *const *lines, size_t count) {
+#ifdef MINISPDLOG_POSIX
+        const size_t chunk = std::min<size_t>(IOV_MAX, 256) / 2;
+        struct iovec iov[256];
+        for (size_t first = 0; first < count; first += chunk) {
+            size_t n = std::min(chunk, count - first);
+            size_t bytes = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const std::string &line = *lines[first + i];
+                iov[2 * i].iov_base = const_cast<char *>(line.data());
+                iov[2 * i].iov_len = line.size();
+                iov[2 * i + 1].iov_base = const_cast<char *>("\n");
+                iov[2 * i + 1].iov_len = 1;
+                bytes += line.size() + 1;
+            }
+            if (!write_iov(iov, static_cast<int>(2 * n), bytes)) {
+                return false;
+            }
+        }
+        return true;
+#else
+        for (size_t i = 0; i < count; ++i) {
+            file_.write(lines[i]->data(),
+                        static_cast<std::streamsize>(lines[i]->size()));
+            file_.put('\n');
+        }
+        file_.flush();
+        return static_cast<bool>(file_);
+#endif
+    }
+
+    /**
+     * Offset just past the last write
+     * With other processes appending to the file this is where our bytes
+     * really ended, which counting them cannot tell.
+     */
+    uint64_t offset() {
+#ifdef MINISPDLOG_POSIX
+        off_t end = fd_ >= 0 ? ::lseek(fd_, 0, SEEK_CUR) : -1;
+        return end >= 0 ? static_cast<uint64_t>(end) : start_ + written_;
+#else
+        return static_cast<uint64_t>(file_.tellp());
+#endif
+    }
+
+    /**
+     * Current size of the file, including what other processes appended
+     */
+    uint64_t size() {
+#ifdef MINISPDLOG_POSIX
+        struct stat st;
+        return fd_ >= 0 && ::fstat(fd_, &st) == 0
+                   ? static_cast<uint64_t>(st.st_size)
+                   : start_ + written_;
+#else
+        return static_cast<uint64_t>(file_.tellp());
+#endif
+    }
+
+    /**
+     * Drop pages written more than `bytes` ago from the page cache
+     * 0 turns it off. Only done on POSIX systems.
+     */
+    void drop_cache(size_t bytes) {
+#ifdef MINISPDLOG_POSIX
+        drop_cache_bytes_ = bytes;
+        next_drop_ = written_ + bytes;
+#else
+        (void)bytes;
+#endif
+    }
+
+    /**
+     * Keep at least half of `bytes` allocated past the end of the file
+     * 0 turns it off. Only done on Linux.
+     */
+    void preallocate(size_t bytes) {
+#ifdef __linux__
+        preallocate_bytes_ = bytes;
+#else
+        (void)bytes;
+#endif
+    }
+
+    bool good() const {
+#ifdef MINISPDLOG_POSIX
+        return !failed_;
+#else
+        return file_.good();
+#endif
+    }
+
+    void clear() {
+#ifdef MINISPDLOG_POSIX
+        failed_ = fd_ < 0;
+#else
+        file_.clear();
+#endif
+    }
+
+    /**
+     * Exchange the open files; the options stay with each object
+     */
+    void swap(LogFile &other) {
+#ifdef MINISPDLOG_POSIX
+        std::swap(fd_, other.fd_);
+        std::swap(failed_, other.failed_);
+        std::swap(start_, other.start_);
+        std::swap(written_, other.written_);
+        std::swap(next_drop_, other.next_drop_);
+        std::swap(dropped_to_, other.dropped_to_);
+        std::swap(started_to_, other.started_to_);
+        std::swap(allocated_to_, other.allocated_to_);
+        std::swap(retry_allocate_, other.retry_allocate_);
+#else
+        file_.swap(other.file_);
+#endif
+    }
+
+  private:
+#ifdef MINISPDLOG_POSIX
+    int fd_ = -1;
+    bool failed_ = false;
+    uint64_t start_ = 0;   // file size when opened
+    uint64_t written_ = 0; // bytes written since
+    size_t drop_cache_bytes_ = 0;
+    size_t preallocate_bytes_ = 0;
+    uint64_t next_drop_ = 0;
+    uint64_t dropped_to_ = 0;   // offset up to which pages were dropped
+    uint64_t started_to_ = 0;   // offset up to which writeback was started
+    uint64_t allocated_to_ = 0; // offset up to which space is allocated
+    uint64_t retry_allocate_ = 0; // written_ before preallocating again
+#else
+    std::ofstream file_;
+#endif
+
+#ifdef MINISPDLOG_POSIX
+    /**
+     * Write all of `iov`, `size` bytes in total, carrying on after short
+     * writes
+     */
+    bool write_iov(struct iovec *next, int count, size_t size) {
+        if (preallocate_bytes_ && written_ >= retry_allocate_ &&
+            start_ + written_ + size + preallocate_bytes_ / 2 >
+                allocated_to_) {
+            allocate_ahead();
+        }
+        while (count > 0) {
+            ssize_t n = ::writev(fd_, next, count);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                failed_ = true;
+                return false;
+            }
+            // Short write (e.g. disk almost full): carry on with the rest
+            size_t done = static_cast<size_t>(n);
+            while (count > 0 && done >= next->iov_len) {
+                done -= next->iov_len;
+                ++next;
+                --count;
+            }
+            if (count > 0) {
+                next->iov_base = static_cast<char *>(next->iov_base) + done;
+                next->iov_len -= done;
+            }
+        }
+        written_ += size;
+        if (drop_cache_bytes_ && written_ >= next_drop_) {
+            drop_written_pages();
+        }
+        return true;
+    }
+
+    /**
+     * Drop the window behind the last one, and start writing back the last
+     * Other processes may append to the file too, so the end comes from the
+     * descriptor's offset.
+     */
+    void drop_written_pages() {
+        next_drop_ = written_ + drop_cache_bytes_;
+        off_t end = ::lseek(fd_, 0, SEEK_CUR);
+        if (end < 0) {
+            return;
+        }
+        uint64_t to = started_to_;
+        started_to_ = static_cast<uint64_t>(end);
+#ifdef __linux__
+        if (to > dropped_to_) {
+            // DONTNEED leaves dirty pages alone: make sure they are clean
+            ::sync_file_range(fd_, static_cast<off_t>(dropped_to_),
+                              static_cast<off_t>(to - dropped_to_),
+                              SYNC_FILE_RANGE_WAIT_BEFORE |
+                                  SYNC_FILE_RANGE_WRITE |
+                                  SYNC_FILE_RANGE_WAIT_AFTER);
+        }
+        if (started_to_ > to) {
+            ::sync_file_range(fd_, static_cast<off_t>(to),
+                              static_cast<off_t>(started_to_ - to),
+                              SYNC_FILE_RANGE_WRITE);
+        }
+#endif
+#if defined(POSIX_FADV_DONTNEED)
+        if (to > dropped_to_) {
+            ::posix_fadvise(fd_, static_cast<off_t>(dropped_to_),
+                            static_cast<off_t>(to - dropped_to_),
+                            POSIX_FADV_DONTNEED);
+            dropped_to_ = to;
+        }
+#endif
+    }
+
+    /**
+     * Allocate the next extent past the current end, keeping the size
+     */
+    void allocate_ahead() {
+#ifdef __linux__
+        off_t end = ::lseek(fd_, 0, SEEK_END);
+        if (end < 0) {
+            return;
+        }
+        uint64_t from = std::max(allocated_to_, static_cast<uint64_t>(end));
+        uint64_t to = static_cast<uint64_t>(end) + preallocate_bytes_;
+        if (to > from &&
+            ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(from),
+                        static_cast<off_t>(to - from)) != 0) {
+            if (errno == EOPNOTSUPP || errno == ENOSYS) {
+                preallocate_bytes_ = 0; // not supported by this file system
+            } else {
+                // e.g. ENOSPC: try again after another half extent
+                retry_allocate_ = written_ + preallocate_bytes_ / 2;
+            }
+            return;
+        }
+        allocated_to_ = std::max(allocated_to_, to);
+        // Our estimate of the end lags if others append: resync it
+        if (static_cast<uint64_t>(end) >= written_) {
+            start_ = static_cast<uint64_t>(end) - written_;
+        }
+#endif
+    }
+#endif
+};
+
+/**
+ * Failure tracking for one output
+ * An output whose write fails, or is slower than its limit, is degraded:
+ * it is left alone until a retry time, the delay doubling after each failed
+ * retry from 100 ms up to 30 s. The first good write after that restores
+ * it. Calls must be serialized; the counters can be read from anywhere.
+ */
+class OutputHealth {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Whether to write now: the output is healthy or due a retry
+     */
+    bool available() const {
+        return !degraded_.load(std::memory_order_relaxed) ||
+               Clock::now() >= retry_at_;
+    }
+
+    /**
+     * Record a good write; true if the output was degraded until now
+     */
+    bool succeeded() {
+        if (!degraded_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        degraded_.store(false, std::memory_order_relaxed);
+        backoff_ = std::chrono::milliseconds(0);
+        return true;
+    }
+
+    /**
+     * Record a failed or slow write; returns the delay before the retry
+     */
+    std::chrono::milliseconds failed() {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        backoff_ = std::min(
+            std::max(backoff_ * 2, std::chrono::milliseconds(MIN_BACKOFF_MS)),
+            std::chrono::milliseconds(MAX_BACKOFF_MS));
+        retry_at_ = Clock::now() + backoff_;
+        degraded_.store(true, std::memory_order_relaxed);
+        return backoff_;
+    }
+
+    /**
+     * Count records the output did not get
+     */
+    void dropped(uint64_t count = 1) {
+        dropped_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    bool degraded() const { return degraded_.load(std::memory_order_relaxed); }
+    uint64_t failures() const {
+        return failures_.load(std::memory_order_relaxed);
+    }
+    uint64_t dropped_count() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    enum : int { MIN_BACKOFF_MS = 100, MAX_BACKOFF_MS = 30000 };
+
+    std::atomic<bool> degraded_{false};
+    std::atomic<uint64_t> failures_{0};
+    std::atomic<uint64_t> dropped_{0};
+    Clock::time_point retry_at_;
+    std::chrono::milliseconds backoff_{0};
+};
+
+/**
+ * Base class for additional log outputs
+ * Sinks receive every record that passes both the logger level and their own
+ * level. In async mode they are called from the worker thread, otherwise from
+ * the logging thread; calls are always serialized by the logger.
+ */
+class Sink {
+  public:
+    explicit Sink(LogLevel level = LogLevel::DEBUG) : level_(level) {}
+    virtual ~Sink() {}
+
+    Sink(const Sink &) = delete;
+    Sink &operator=(const Sink &) = delete;
+
+    virtual void write(const LogRecord &record) = 0;
+    virtual void flush() {}
+
+    /**
+     * Whether the sink can still write
+     * Checked after each write, as are exceptions thrown by write(); sinks
+     * backed by a stream report its state.
+     */
+    virtual bool good() const { return true; }
+
+    /**
+     * Write through the health checks; the logger calls this, not write()
+     * While the sink is degraded (see OutputHealth) records are dropped and
+     * counted, and copied to stderr unless disabled.
+     */
+    void checked_write(const LogRecord &record) {
+        if (!health_.available()) {
+            drop(record);
+            return;
+        }
+        if (health_.degraded()) {
+            recover();
+        }
+        auto start = max_latency_.count() ? OutputHealth::Clock::now()
+                                          : OutputHealth::Clock::time_point();
+        bool ok;
+        try {
+            write(record);
+            ok = good();
+        } catch (const std::exception &) {
+            ok = false;
+        }
+        if (!ok) {
+            report("write failed", health_.failed());
+            drop(record);
+        } else if (max_latency_.count() &&
+                   OutputHealth::Clock::now() - start > max_latency_) {
+            report("too slow", health_.failed());
+        } else if (health_.succeeded()) {
+            std::cerr << "minispdlog: sink recovered, "
+                      << health_.dropped_count() << " records dropped so far"
+                      << std::endl;
+        }
+    }
+
+    /**
+     * Flush, skipped while the sink is degraded
+     */
+    void checked_flush() {
+        if (!health_.available()) {
+            return;
+        }
+        if (health_.degraded()) {
+            recover();
+        }
+        try {
+            flush();
+            if (good()) {
+                return;
+            }
+        } catch (const std::exception &) {
+        }
+        report("flush failed", health_.failed());
+    }
+
+    /**
+     * Degrade the sink when a write takes longer than `max_latency`
+     * 0, the default, only checks for errors. With `stderr_fallback` off,
+     * records are dropped silently while the sink is degraded. Meant to be
+     * called before the sink is added to a logger.
+     */
+    void set_health_policy(std::chrono::microseconds max_latency,
+                           bool stderr_fallback = true) {
+        max_latency_ = max_latency;
+        stderr_fallback_ = stderr_fallback;
+    }
+
+    const OutputHealth &health() const { return health_; }
+
+    /**
+     * Whether the sink wants timing spans
+     * Span records have no entry text; sinks returning true receive only
+     * them.
+     */
+    virtual bool accepts_spans() const { return false; }
+
+    inline void set_level(LogLevel level) { level_ = level; }
+    inline bool should_write(LogLevel level) const { return level >= level_; }
+
+  protected:
+    /**
+     * Called before each retry of a degraded sink
+     * Sinks backed by a stream clear its error state here, or good() would
+     * keep failing after the cause is gone.
+     */
+    virtual void recover() {}
+
+    /**
+     * Count records accepted by write() that could not be delivered, e.g.
+     * a buffer lost to a failed flush
+     */
+    void lost(uint64_t count) { health_.dropped(count); }
+
+  private:
+    std::atomic<LogLevel> level_;
+    OutputHealth health_;
+    std::chrono::microseconds max_latency_{0};
+    bool stderr_fallback_ = true;
+
+    void drop(const LogRecord &record) {
+        health_.dropped();
+        if (stderr_fallback_ && !record.span_name) {
+            std::cerr << record.entry << '\n';
+        }
+    }
+
+    static void report(const char *what, std::chrono::milliseconds retry) {
+        std::cerr << "minispdlog: sink " << what << ", retrying in "
+                  << retry.count() << " ms" << std::endl;
+    }
+};
+
+/**
+ * In-memory ring sink
+ * Keeps the last `capacity` records in memory, each truncated to
+ * `max_entry_size` bytes. Appending is lock-free: a writer takes a ticket
+ * from an atomic counter and claims its slot by moving the slot's sequence
+ * number from an older ticket to its own with a compare-and-swap, so a
+ * writer a lap behind never overwrites a newer record. snapshot() can run
+ * from any thread (tests, diagnostic endpoints) without blocking the
+ * logger; the slot contents are copied through relaxed atomic words and
+ * checked against the sequence number, and slots caught in the middle of a
+ * write are skipped.
+ */
+class RingSink : public Sink {
+  public:
+    explicit RingSink(size_t capacity = 1024, size_t max_entry_size = 512,
+                      LogLevel level = LogLevel::DEBUG)
+        : Sink(level), capacity_(std::max<size_t>(capacity, 1)),
+          max_entry_size_(max_entry_size),
+          slot_words_((max_entry_size + sizeof(uint64_t) - 1) /
+                      sizeof(uint64_t)),
+          next_(0), slots_(new Slot[capacity_]),
+          storage_(new std::atomic<uint64_t>[capacity_ * slot_words_]) {}
+
+    void write(const LogRecord &record) override {
+        append(record.level, record.entry);
+    }
+
+    /**
+     * Append an entry; safe to call from several threads at once
+     */
+    void append(LogLevel level, const std::string &entry) {
+        uint64_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+        Slot &slot = slots_[ticket % capacity_];
+        uint64_t version = slot.version.load(std::memory_order_relaxed);
+        for (;;) {
+            if (version >= 2 * ticket + 1) {
+                return; // a later lap has the slot: this entry is already old
+            }
+            if (version % 2 != 0) {
+                // The writer of an earlier lap is still copying
+                std::this_thread::yield();
+                version = slot.version.load(std::memory_order_relaxed);
+            } else if (slot.version.compare_exchange_weak(
+                           version, 2 * ticket + 1,
+                           std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        size_t size = std::min(entry.size(), max_entry_size_);
+        std::atomic<uint64_t> *words = slot_data(ticket);
+        for (size_t offset = 0; offset < size; offset += sizeof(uint64_t)) {
+            uint64_t word = 0;
+            std::memcpy(&word, entry.data() + offset,
+                        std::min(sizeof(uint64_t), size - offset));
+            words[offset / sizeof(uint64_t)].store(word,
+                                                   std::memory_order_relaxed);
+        }
+        slot.level.store(level, std::memory_order_relaxed);
+        slot.size.store(size, std::memory_order_relaxed);
+        slot.version.store(2 * ticket + 2, std::memory_order_release);
+    }
+
+    /**
+     * Copy the records currently in the ring, oldest first
+     */
+    std::vector<LogRecord> snapshot() const {
+        std::vector<std::pair<uint64_t, LogRecord>> found;
+        found.reserve(capacity_);
+        std::string data;
+        for (size_t i = 0; i < capacity_; ++i) {
+            const Slot &slot = slots_[i];
+            uint64_t before = slot.version.load(std::memory_order_acquire);
+            if (before == 0 || before % 2 != 0) {
+                continue;
+            }
+            uint64_t ticket = before / 2 - 1;
+            LogLevel level = slot.level.load(std::memory_order_relaxed);
+            size_t size = std::min(slot.size.load(std::memory_order_relaxed),
+                                   max_entry_size_);
+            data.resize(size);
+            const std::atomic<uint64_t> *words = slot_data(ticket);
+            for (size_t offset = 0; offset < size;
+                 offset += sizeof(uint64_t)) {
+                uint64_t word = words[offset / sizeof(uint64_t)].load(
+                    std::memory_order_relaxed);
+                std::memcpy(&data[offset], &word,
+                            std::min(sizeof(uint64_t), size - offset));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.version.load(std::memory_order_relaxed) == before) {
+                LogRecord record{level, data};
+                record.seq = ticket;
+                found.emplace_back(ticket, std::move(record));
+            }
+        }
+        std::sort(found.begin(), found.end(),
+                  [](const std::pair<uint64_t, LogRecord> &a,
+                     const std::pair<uint64_t, LogRecord> &b) {
+                      return a.first < b.first;
+                  });
+        std::vector<LogRecord> records;
+        records.reserve(found.size());
+        for (auto &item : found) {
+            records.push_back(std::move(item.second));
+        }
+        return records;
+    }
+
+    /**
+     * Check whether any record in the ring contains `text`
+     */
+    bool contains(const std::string &text) const {
+        for (const auto &record : snapshot()) {
+            if (record.entry.find(text) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Number of records appended since creation, including overwritten ones
+     */
+    inline uint64_t total() const { return next_.load(); }
+
+  private:
+    struct Slot {
+        std::atomic<uint64_t> version{0}; // odd while being written
+        std::atomic<LogLevel> level{LogLevel::DEBUG};
+        std::atomic<size_t> size{0};
+    };
+
+    size_t capacity_;
+    size_t max_entry_size_;
+    size_t slot_words_;
+    std::atomic<uint64_t> next_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<std::atomic<uint64_t>[]> storage_;
+
+    inline std::atomic<uint64_t> *slot_data(uint64_t ticket) const {
+        return storage_.get() + (ticket % capacity_) * slot_words_;
+    }
+};
+
+/**
+ * Chrome trace-event sink
+ * Writes the spans recorded with SLOG_SCOPE as "complete" events of the
+ * trace-event JSON array format, which chrome://tracing and Perfetto open
+ * directly. The closing bracket is written on destruction; both viewers also
+ * accept a file cut short by a crash.
+ */
+class TraceEventSink : public Sink {
+  public:
+    explicit TraceEventSink(const std::string &filename)
+        : pid_(current_pid()), first_(true) {
+        file_.open(filename, std::ios::trunc);
+        if (!file_.is_open()) {
+            throw std::runtime_error("Unable to open trace file: " + filename);
+        }
+        file_ << "[\n";
+    }
+
+    ~TraceEventSink() override { file_ << "\n]\n"; }
+
+    bool accepts_spans() const override { return true; }
+
+    void write(const LogRecord &record) override {
+        if (!record.span_name) {
+            return;
+        }
+        file_ << (first_ ? "" : ",\n") << "{\"name\":\"";
+        write_escaped(record.span_name);
+        file_ << "\",\"cat\":\"scope\",\"ph\":\"X\",\"ts\":"
+              << record.span_start_us << ",\"dur\":" << record.span_duration_us
+              << ",\"pid\":" << pid_ << ",\"tid\":" << record.thread_id << "}";
+        first_ = false;
+    }
+
+    void flush() override { file_.flush(); }
+    bool good() const override { return file_.good(); }
+
+  protected:
+    void recover() override { file_.clear(); }
+
+  private:
+    std::ofstream file_;
+    long pid_;
+    bool first_;
+
+    static long current_pid() {
+#ifdef MINISPDLOG_POSIX
+        return static_cast<long>(::getpid());
+#else
+        return 0;
+#endif
+    }
+
+    void write_escaped(const char *text) {
+        for (; *text; ++text) {
+            unsigned char c = static_cast<unsigned char>(*text);
+            if (c == '"' || c == '\\') {
+                file_ << '\\' << *text;
+            } else if (c < 0x20) {
+                file_ << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                      << static_cast<int>(c) << std::dec;
+            } else {
+                file_ << *text;
+            }
+        }
+    }
+};
+
+#ifdef MINISPDLOG_POSIX
+/**
+ * Flight recorder sink
+ * Records are copied into a fixed-size circular buffer backed by a shared
+ * memory mapping of a file. Writing a record is a memcpy and no syscall; the
+ * data lives in the page cache, so the last records survive a SIGKILL or an
+ * OOM kill of the process and can be decoded afterwards with decode().
+ */
+class FlightRecorderSink : public Sink {
+  public:
+    /**
+     * On-disk header, followed by `capacity` bytes of ring data
+     * `head` counts all bytes ever written; the next write goes to
+     * head % capacity and the ring has wrapped once head > capacity.
+     */
+    struct Header {
+        char magic[8];
+        uint64_t capacity;
+        uint64_t head;
+    };
+
+    FlightRecorderSink(const std::string &filename, size_t capacity,
+                       LogLevel level = LogLevel::DEBUG)
+        : Sink(level), header_(nullptr), data_(nullptr), capacity_(capacity),
+          map_size_(sizeof(Header) + capacity) {
+        if (capacity_ == 0) {
+            throw std::runtime_error("Flight recorder capacity must be > 0");
+        }
+        int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open flight recorder file: " +
+                                     filename);
+        }
+        if (::ftruncate(fd, static_cast<off_t>(map_size_)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Unable to size flight recorder file: " +
+                                     filename);
+        }
+        void *map = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            throw std::runtime_error("Unable to map flight recorder file: " +
+                                     filename);
+        }
+        header_ = static_cast<Header *>(map);
+        data_ = static_cast<char *>(map) + sizeof(Header);
+        // A ring left by a previous run with the same geometry is continued,
+        // anything else is started from scratch.
+        if (std::strncmp(header_->magic, magic(), sizeof(header_->magic)) != 0 ||
+            header_->capacity != capacity_) {
+            std::memset(header_->magic, 0, sizeof(header_->magic));
+            std::strncpy(header_->magic, magic(), sizeof(header_->magic) - 1);
+            header_->capacity = capacity_;
+            header_->head = 0;
+        }
+    }
+
+    ~FlightRecorderSink() override {
+        if (header_) {
+            ::munmap(header_, map_size_);
+        }
+    }
+
+    void write(const LogRecord &record) override {
+        append(record.entry.data(), record.entry.size());
+        append("\n", 1);
+    }
+
+    /**
+     * Decode a flight recorder file
+     * Returns the recorded lines from oldest to newest. When the ring has
+     * wrapped, the first (partially overwritten) line is skipped.
+     */
+    static std::string decode(const std::string &filename) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Unable to open flight recorder file: " +
+                                     filename);
+        }
+        Header header;
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            std::strncmp(header.magic, magic(), sizeof(header.magic)) != 0) {
+            throw std::runtime_error("Not a flight recorder file: " + filename);
+        }
+        std::string data(header.capacity, '\0');
+        if (!file.read(&data[0], static_cast<std::streamsize>(data.size()))) {
+            throw std::runtime_error("Truncated flight recorder file: " +
+                                     filename);
+        }
+        if (header.head <= header.capacity) {
+            return data.substr(0, header.head);
+        }
+        size_t pos = header.head % header.capacity;
+        std::string ordered = data.substr(pos) + data.substr(0, pos);
+        size_t first = ordered.find('\n');
+        return first == std::string::npos ? std::string()
+                                          : ordered.substr(first + 1);
+    }
+
+  private:
+    Header *header_;
+    char *data_;
+    size_t capacity_;
+    size_t map_size_;
+
+    static const char *magic() { return "SLOGFR1"; }
+
+    void append(const char *src, size_t len) {
+        if (len > capacity_) {
+            src += len - capacity_;
+            len = capacity_;
+        }
+        uint64_t head = header_->head;
+        size_t pos = head % capacity_;
+        size_t first = std::min(len, capacity_ - pos);
+        std::memcpy(data_ + pos, src, first);
+        std::memcpy(data_, src + first, len - first);
+        header_->head = head + len;
+    }
+};
+#endif // MINISPDLOG_POSIX
+
+/**
+ * Self-contained LZ4 block codec
+ * Produces and reads the LZ4 block format (token, literals, 16-bit offset,
+ * match length) with a single-probe hash table. It trades some ratio for
+ * speed and has no dependency outside the standard library.
+ */
+class Lz4Codec {
+  public:
+    static std::string compress(const char *src, size_t size) {
+        std::string out;
+        out.reserve(size + size / 255 + 16);
+        std::vector<uint32_t> table(HASH_SIZE, NO_POSITION);
+        size_t anchor = 0;
+        size_t ip = 0;
+        if (size > MIN_INPUT) {
+            const size_t match_limit = size - MFLIMIT;
+            const size_t copy_limit = size - LAST_LITERALS;
+            unsigned misses = 0;
+            while (ip < match_limit) {
+                uint32_t sequence = read32(src + ip);
+                uint32_t &slot = table[hash(sequence)];
+                size_t ref = slot;
+                slot = static_cast<uint32_t>(ip);
+                if (ref == NO_POSITION || ip - ref > MAX_OFFSET ||
+                    read32(src + ref) != sequence) {
+                    ip += 1 + (misses++ >> SKIP_TRIGGER);
+                    continue;
+                }
+                misses = 0;
+                size_t length = MIN_MATCH;
+                while (ip + length < copy_limit &&
+                       src[ref + length] == src[ip + length]) {
+                    ++length;
+                }
+                emit_sequence(out, src + anchor, ip - anchor, ip - ref, length);
+                ip += length;
+                anchor = ip;
+            }
+        }
+        emit_sequence(out, src + anchor, size - anchor, 0, 0);
+        return out;
+    }
+
+    /**
+     * Decompress a block whose original size is known
+     * Throws std::runtime_error on malformed input.
+     */
+    static std::string decompress(const char *src, size_t size,
+                                  size_t raw_size) {
+        std::string out;
+        out.reserve(raw_size);
+        const unsigned char *ip = reinterpret_cast<const unsigned char *>(src);
+        const unsigned char *end = ip + size;
+        while (ip < end) {
+            unsigned token = *ip++;
+            size_t literals = read_length(ip, end, token >> 4);
+            if (literals > static_cast<size_t>(end - ip) ||
+                out.size() + literals > raw_size) {
+                throw std::runtime_error("Corrupted compressed block");
+            }
+            out.append(reinterpret_cast<const char *>(ip), literals);
+            ip += literals;
+            if (ip == end) {
+                break;
+            }
+            if (end - ip < 2) {
+                throw std::runtime_error("Corrupted compressed block");
+            }
+            size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+            ip += 2;
+            size_t length = read_length(ip, end, token & 0x0f) + MIN_MATCH;
+            if (offset == 0 || offset > out.size() ||
+                out.size() + length > raw_size) {
+                throw std::runtime_error("Corrupted compressed block");
+            }
+            // Byte by byte, since the match may overlap what it produces
+            size_t from = out.size() - offset;
+            for (size_t i = 0; i < length; ++i) {
+                out.push_back(out[from + i]);
+            }
+        }
+        if (out.size() != raw_size) {
+            throw std::runtime_error("Corrupted compressed block");
+        }
+        return out;
+    }
+
+  private:
+    enum : uint32_t {
+        HASH_LOG = 14,
+        HASH_SIZE = 1u << HASH_LOG,
+        NO_POSITION = 0xffffffffu,
+        MAX_OFFSET = 65535,
+        MIN_MATCH = 4,
+        LAST_LITERALS = 5, // the block always ends with literals
+        MFLIMIT = 12,      // no match may start in the last 12 bytes
+        MIN_INPUT = 13,
+        SKIP_TRIGGER = 6,  // probe less often after repeated misses
+    };
+
+    static inline uint32_t read32(const char *p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static inline uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_LOG);
+    }
+
+    static void write_length(std::string &out, size_t length) {
+        while (length >= 255) {
+            out.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    static size_t read_length(const unsigned char *&ip,
+                              const unsigned char *end, size_t length) {
+        if (length != 15) {
+            return length;
+        }
+        unsigned char byte;
+        do {
+            if (ip == end) {
+                throw std::runtime_error("Corrupted compressed block");
+            }
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return length;
+    }
+
+    /**
+     * Emit literals followed by a match; a zero match length ends the block
+     */
+    static void emit_sequence(std::string &out, const char *literals,
+                              size_t literal_length, size_t offset,
+                              size_t match_length) {
+        size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+        unsigned token =
+            (literal_length >= 15 ? 15u
+                                  : static_cast<unsigned>(literal_length)) << 4 |
+            (match_code >= 15 ? 15u : static_cast<unsigned>(match_code));
+        out.push_back(static_cast<char>(token));
+        if (literal_length >= 15) {
+            write_length(out, literal_length - 15);
+        }
+        out.append(literals, literal_length);
+        if (match_length == 0) {
+            return;
+        }
+        out.push_back(static_cast<char>(offset & 0xff));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (match_code >= 15) {
+            write_length(out, match_code - 15);
+        }
+    }
+};
+
+/**
+ * Plain file sink
+ * Entries are collected in a buffer and appended with a single write (see
+ * LogFile) when the logger flushes its sinks at the end of a batch, or once
+ * the buffer holds `buffer_size` bytes. After a failed write, entries are
+ * written through until the file works again.
+ */
+class FileSink : public Sink {
+  public:
+    explicit FileSink(const std::string &filename,
+                      LogLevel level = LogLevel::DEBUG,
+                      size_t buffer_size = 64 * 1024)
+        : Sink(level), filename_(filename), buffer_size_(buffer_size) {
+        if (!file_.open(filename)) {
+            throw std::runtime_error("Unable to open log file: " + filename);
+        }
+        buffer_.reserve(buffer_size_ + 1024);
+    }
+
+    ~FileSink() override { FileSink::flush(); }
+
+    void write(const LogRecord &record) override {
+        buffer_ += record.entry;
+        buffer_ += '\n';
+        buffered_++;
+        if (buffer_.size() >= buffer_size_ || !file_.good()) {
+            // If this fails, checked_write() counts the record itself
+            write_buffer(buffered_ - 1);
+        }
+    }
+
+    void flush() override { write_buffer(buffered_); }
+
+    bool good() const override { return file_.good(); }
+
+    /**
+     * See LogFile::drop_cache() and LogFile::preallocate(); meant to be
+     * called before the sink is added to a logger
+     */
+    void drop_cache(size_t bytes) { file_.drop_cache(bytes); }
+    void preallocate(size_t bytes) { file_.preallocate(bytes); }
+
+  protected:
+    std::string filename_;
+    LogFile file_;
+    std::string buffer_;
+    size_t buffer_size_;
+    uint64_t buffered_ = 0; // records in buffer_
+
+    /**
+     * Write the buffer out; if that fails, the first `counted` records in
+     * it are counted as lost
+     */
+    void write_buffer(uint64_t counted) {
+        if (buffer_.empty()) {
+            return;
+        }
+        file_.clear();
+        if (!file_.write(buffer_.data(), buffer_.size())) {
+            lost(counted);
+        }
+        buffer_.clear();
+        buffered_ = 0;
+    }
+};
+
+/**
+ * Standard output or standard error sink
+ * Entries are collected in a buffer and written with a single call when the
+ * logger flushes its sinks at the end of a batch, or once the buffer holds
+ * `buffer_size` bytes, instead of one flush per line. With Color::AUTO the
+ * level tag is colored only when the stream is a terminal and NO_COLOR is
+ * not set; the escape sequences are fixed per level.
+ */
+class ConsoleSink : public Sink {
+  public:
+    enum class Stream { STDOUT, STDERR };
+    enum class Color { AUTO, ALWAYS, NEVER };
+
+    explicit ConsoleSink(Stream stream = Stream::STDOUT,
+                         LogLevel level = LogLevel::DEBUG,
+                         Color color = Color::AUTO,
+                         size_t buffer_size = 16 * 1024)
+        : Sink(level), stream_(stream), buffer_size_(buffer_size) {
+        color_ = color == Color::ALWAYS ||
+                 (color == Color::AUTO && is_terminal() &&
+                  !std::getenv("NO_COLOR"));
+        buffer_.reserve(buffer_size_ + 1024);
+    }
+
+    ~ConsoleSink() override { ConsoleSink::flush(); }
+
+    void write(const LogRecord &record) override {
+        // The level tag is the first bracket, right after the timestamp
+        size_t open = color_ ? record.entry.find('[') : std::string::npos;
+        size_t close = open == std::string::npos
+                           ? std::string::npos
+                           : record.entry.find(']', open);
+        if (close == std::string::npos) {
+            buffer_ += record.entry;
+        } else {
+            buffer_.append(record.entry, 0, open);
+            buffer_ += level_color(record.level);
+            buffer_.append(record.entry, open, close + 1 - open);
+            buffer_ += "\033[0m";
+            buffer_.append(record.entry, close + 1, std::string::npos);
+        }
+        buffer_ += '\n';
+        if (buffer_.size() >= buffer_size_) {
+            flush();
+        }
+    }
+
+    void flush() override {
+        if (buffer_.empty()) {
+            return;
+        }
+#ifdef MINISPDLOG_POSIX
+        int fd = stream_ == Stream::STDOUT ? STDOUT_FILENO : STDERR_FILENO;
+        const char *data = buffer_.data();
+        size_t left = buffer_.size();
+        failed_ = false;
+        while (left > 0) {
+            ssize_t n = ::write(fd, data, left);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                failed_ = true;
+                break;
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+#else
+        FILE *file = stream_ == Stream::STDOUT ? stdout : stderr;
+        failed_ = std::fwrite(buffer_.data(), 1, buffer_.size(), file) !=
+                      buffer_.size() ||
+                  std::fflush(file) != 0;
+#endif
+        buffer_.clear();
+    }
+
+    bool good() const override { return !failed_; }
+
+    bool colored() const { return color_; }
+
+  private:
+    Stream stream_;
+    size_t buffer_size_;
+    bool color_;
+    bool failed_ = false;
+    std::string buffer_;
+
+    bool is_terminal() const {
+#ifdef MINISPDLOG_POSIX
+        return ::isatty(stream_ == Stream::STDOUT ? STDOUT_FILENO
+                                                  : STDERR_FILENO) == 1;
+#else
+        return false;
+#endif
+    }
+
+    static const char *level_color(LogLevel level) {
+        static const char *const COLORS[] = {
+            "\033[36m",   // DEBUG: cyan
+            "\033[32m",   // INFO: green
+            "\033[33m",   // WARN: yellow
+            "\033[31m",   // ERROR: red
+            "\033[1;31m", // CRITICAL: bold red
+        };
+        return COLORS[static_cast<int>(level)];
+    }
+};
+
+/**
+ * Compressed file sink
+ * Records are accumulated into blocks that are compressed with Lz4Codec and
+ * appended to the file; in async mode this happens on the worker thread. The
+ * file starts with the "SLZ1" magic and each block is framed as
+ *
+ *     uint32 raw size | uint32 stored size (high bit: stored uncompressed)
+ *
+ * both little endian, followed by the block data. Use decompress() or the
+ * slog_unz tool to read it back. Records are held in memory until the
+ * block fills up or the logger flushes its sinks, at the end of each batch
+ * or on Logger::flush(); a flushed partial block is written as a shorter
+ * frame, so under light traffic blocks are small and compress less.
+ */
+class CompressedFileSink : public Sink {
+  public:
+    CompressedFileSink(const std::string &filename,
+                       size_t block_size = 256 * 1024,
+                       LogLevel level = LogLevel::DEBUG)
+        : Sink(level), block_size_(std::max<size_t>(block_size, 1024)) {
+        file_.open(filename, std::ios::binary | std::ios::app);
+        if (!file_.is_open()) {
+            throw std::runtime_error("Unable to open compressed log file: " +
+                                     filename);
+        }
+        // A new file, or one appended to, starts with the magic anyway:
+        // the reader accepts it between blocks.
+        file_.write(magic(), MAGIC_SIZE);
+        buffer_.reserve(block_size_ + 1024);
+    }
+
+    ~CompressedFileSink() override { write_block(); }
+
+    void write(const LogRecord &record) override {
+        buffer_ += record.entry;
+        buffer_ += '\n';
+        if (buffer_.size() >= block_size_) {
+            write_block();
+        }
+    }
+
+    void flush() override { write_block(); }
+
+    bool good() const override { return file_.good(); }
+
+    /**
+     * Compress a whole file into the format written by this sink
+     * Throws std::runtime_error if either file cannot be used.
+     */
+    static void compress_file(const std::string &source,
+                              const std::string &target,
+                              size_t block_size = 256 * 1024) {
+        std::ifstream in(source, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Unable to open file: " + source);
+        }
+        std::ofstream out(target, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to open file: " + target);
+        }
+        out.write(magic(), MAGIC_SIZE);
+        std::string block(block_size, '\0');
+        while (in.read(&block[0], static_cast<std::streamsize>(block.size())) ||
+               in.gcount() > 0) {
+            block.resize(static_cast<size_t>(in.gcount()));
+            write_frame(out, block);
+            block.resize(block_size);
+        }
+        if (!out.flush()) {
+            throw std::runtime_error("Unable to write file: " + target);
+        }
+    }
+
+    /**
+     * Decompress a stream written by this sink
+     * Throws std::runtime_error if the stream ends inside a frame.
+     */
+    static void decompress(std::istream &in, std::ostream &out) {
+        char frame[8];
+        for (;;) {
+            if (!in.read(frame, 4)) {
+                if (in.gcount() != 0) {
+                    throw std::runtime_error("Truncated compressed log");
+                }
+                return;
+            }
+            if (std::memcmp(frame, magic(), MAGIC_SIZE) == 0) {
+                continue;
+            }
+            if (!in.read(frame + 4, 4)) {
+                throw std::runtime_error("Truncated compressed log");
+            }
+            uint32_t raw_size = read_le32(frame);
+            uint32_t stored_size = read_le32(frame + 4);
+            bool is_raw = (stored_size & RAW_FLAG) != 0;
+            stored_size &= ~RAW_FLAG;
+            std::string data(stored_size, '\0');
+            if (!in.read(&data[0], stored_size)) {
+                throw std::runtime_error("Truncated compressed log");
+            }
+            if (is_raw) {
+                out << data;
+            } else {
+                out << Lz4Codec::decompress(data.data(), data.size(), raw_size);
+            }
+        }
+    }
+
+  protected:
+    void recover() override { file_.clear(); }
+
+  private:
+    enum : uint32_t { MAGIC_SIZE = 4, RAW_FLAG = 0x80000000u };
+
+    std::ofstream file_;
+    std::string buffer_;
+    size_t block_size_;
+
+    static const char *magic() { return "SLZ1"; }
+
+    static uint32_t read_le32(const char *p) {
+        const unsigned char *b = reinterpret_cast<const unsigned char *>(p);
+        return static_cast<uint32_t>(b[0]) | static_cast<uint32_t>(b[1]) << 8 |
+               static_cast<uint32_t>(b[2]) << 16 |
+               static_cast<uint32_t>(b[3]) << 24;
+    }
+
+    static void write_le32(std::ostream &out, uint32_t value) {
+        char b[4] = {static_cast<char>(value & 0xff),
+                     static_cast<char>((value >> 8) & 0xff),
+                     static_cast<char>((value >> 16) & 0xff),
+                     static_cast<char>((value >> 24) & 0xff)};
+        out.write(b, 4);
+    }
+
+    static void write_frame(std::ostream &out, const std::string &block) {
+        std::string packed = Lz4Codec::compress(block.data(), block.size());
+        bool is_raw = packed.size() >= block.size();
+        const std::string &data = is_raw ? block : packed;
+        write_le32(out, static_cast<uint32_t>(block.size()));
+        write_le32(out, static_cast<uint32_t>(data.size()) |
+                            (is_raw ? uint32_t(RAW_FLAG) : 0u));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    void write_block() {
+        if (buffer_.empty()) {
+            return;
+        }
+        write_frame(file_, buffer_);
+        file_.flush();
+        buffer_.clear();
+    }
+};
+
+#ifdef MINISPDLOG_POSIX
+/**
+ * Retention manager for rotated log files
+ * Runs a low-priority background thread that compresses rotated files into
+ * ".slz" files (CompressedFileSink format) and deletes the oldest ones while
+ * they exceed the configured total size or age, or while free disk space is
+ * below the minimum. Free space is checked once per pass and cached, so
+ * nothing here runs on the logging path: rotating sinks only call
+ * notify_rotated(), which wakes the thread up.
+ *
+ * Rotated files are recognized by name, "<log file>.<timestamp>[.slz]", as
+ * written by RotatingFileSink.
+ */
+class RetentionManager {
+  public:
+    struct Policy {
+        uint64_t max_total_bytes = 0;             // 0: no size limit
+        std::chrono::seconds max_age{0};          // 0: no age limit
+        uint64_t min_free_bytes = 0;              // 0: no free space check
+        bool compress = true;
+        std::chrono::seconds check_interval{60};
+    };
+
+    RetentionManager(const std::string &filename, const Policy &policy)
+        : policy_(policy), free_bytes_(UINT64_MAX), stop_thread_(false),
+          pending_(true) {
+        size_t slash = filename.rfind('/');
+        directory_ = slash == std::string::npos ? "." : filename.substr(0, slash);
+        prefix_ = (slash == std::string::npos ? filename
+                                              : filename.substr(slash + 1)) +
+                  ".";
+        worker_thread_ = std::thread(&RetentionManager::worker_function, this);
+    }
+
+    ~RetentionManager() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_thread_ = true;
+        }
+        cv_.notify_all();
+        if (worker_thread_.joinable()) {
+            worker_thread_.join();
+        }
+    }
+
+    RetentionManager(const RetentionManager &) = delete;
+    RetentionManager &operator=(const RetentionManager &) = delete;
+
+    /**
+     * Signal that a file has been rotated
+     * Only sets a flag and wakes the background thread.
+     */
+    void notify_rotated() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    /**
+     * Free space on the log file system as of the last pass
+     */
+    inline uint64_t free_bytes() const { return free_bytes_; }
+
+    /**
+     * Run a full compression and cleanup pass on the calling thread
+     */
+    void run_once() {
+        std::lock_guard<std::mutex> pass_lock(pass_mutex_);
+        if (policy_.compress) {
+            compress_rotated();
+        }
+        enforce_limits();
+    }
+
+  private:
+    struct RotatedFile {
+        std::string path;
+        uint64_t size;
+        time_t mtime;
+    };
+
+    Policy policy_;
+    std::string directory_;
+    std::string prefix_;
+    std::atomic<uint64_t> free_bytes_;
+    std::thread worker_thread_;
+    std::mutex mutex_;
+    std::mutex pass_mutex_;
+    std::condition_variable cv_;
+    bool stop_thread_;
+    bool pending_;
+
+    void worker_function() {
+#ifdef __linux__
+        // On Linux the nice value is per thread
+        ::setpriority(PRIO_PROCESS, 0, 19);
+#endif
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_thread_) {
+            cv_.wait_for(lock, policy_.check_interval,
+                         [this] { return pending_ || stop_thread_; });
+            if (stop_thread_) {
+                break;
+            }
+            pending_ = false;
+            lock.unlock();
+            try {
+                run_once();
+            } catch (const std::exception &) {
+                // Retried on the next pass
+            }
+            lock.lock();
+        }
+    }
+
+    static bool ends_with(const std::string &s, const std::string &suffix) {
+        return s.size() >= suffix.size() &&
+               s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    /**
+     * List rotated files, oldest first
+     * Timestamped names sort chronologically.
+     */
+    std::vector<RotatedFile> list_rotated() {
+        std::vector<RotatedFile> files;
+        DIR *dir = ::opendir(directory_.c_str());
+        if (!dir) {
+            return files;
+        }
+        while (struct dirent *entry = ::readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() <= prefix_.size() ||
+                name.compare(0, prefix_.size(), prefix_) != 0 ||
+                !std::isdigit(static_cast<unsigned char>(name[prefix_.size()]))) {
+                continue;
+            }
+            std::string path = directory_ + "/" + name;
+            struct stat st;
+            if (::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                files.push_back({path, static_cast<uint64_t>(st.st_size),
+                                 st.st_mtime});
+            }
+        }
+        ::closedir(dir);
+        std::sort(files.begin(), files.end(),
+                  [](const RotatedFile &a, const RotatedFile &b) {
+                      return a.path < b.path;
+                  });
+        return files;
+    }
+
+    void compress_rotated() {
+        for (const auto &file : list_rotated()) {
+            if (ends_with(file.path, ".slz")) {
+                continue;
+            }
+            if (ends_with(file.path, ".tmp")) {
+                ::unlink(file.path.c_str()); // left by an interrupted pass
+                continue;
+            }
+            std::string tmp = file.path + ".slz.tmp";
+            CompressedFileSink::compress_file(file.path, tmp);
+            // Ages are taken from mtimes: keep the rotation time, not the
+            // compression time
+            struct stat st;
+            if (::stat(file.path.c_str(), &st) == 0) {
+                struct timespec times[2] = {st.st_atim, st.st_mtim};
+                ::utimensat(AT_FDCWD, tmp.c_str(), times, 0);
+            }
+            if (std::rename(tmp.c_str(), (file.path + ".slz").c_str()) == 0) {
+                ::unlink(file.path.c_str());
+            }
+        }
+    }
+
+    void enforce_limits() {
+        refresh_free_bytes();
+        std::vector<RotatedFile> files = list_rotated();
+        uint64_t total = 0;
+        for (const auto &file : files) {
+            total += file.size;
+        }
+        time_t now = std::time(nullptr);
+        for (const auto &file : files) {
+            bool too_big = policy_.max_total_bytes && total > policy_.max_total_bytes;
+            bool too_old = policy_.max_age.count() &&
+                           now - file.mtime > policy_.max_age.count();
+            bool disk_low = policy_.min_free_bytes &&
+                            free_bytes_ < policy_.min_free_bytes;
+            if (!too_big && !too_old && !disk_low) {
+                break;
+            }
+            if (::unlink(file.path.c_str()) == 0) {
+                total -= file.size;
+                if (disk_low) {
+                    refresh_free_bytes();
+                }
+            }
+        }
+    }
+
+    void refresh_free_bytes() {
+        struct statvfs fs;
+        if (::statvfs(directory_.c_str(), &fs) == 0) {
+            free_bytes_ = static_cast<uint64_t>(fs.f_bavail) * fs.f_frsize;
+        }
+    }
+};
+
+/**
+ * Size-based rotating file sink
+ * When the file reaches `max_bytes` it is renamed to
+ * "<file>.<YYYYmmdd-HHMMSS-uuuuuu>" and a new file is started. An optional
+ * RetentionManager is notified after each rotation to compress and prune the
+ * rotated files in the background.
+ */
+class RotatingFileSink : public FileSink {
+  public:
+    RotatingFileSink(const std::string &filename, uint64_t max_bytes,
+                     std::shared_ptr<RetentionManager> retention = nullptr,
+                     LogLevel level = LogLevel::DEBUG)
+        : FileSink(filename, level), max_bytes_(max_bytes),
+          retention_(std::move(retention)), size_(current_size()) {}
+
+    void write(const LogRecord &record) override {
+        if (!file_.is_open() ||
+            (size_ > 0 && size_ + record.entry.size() + 1 > max_bytes_)) {
+            rotate();
+        }
+        size_ += record.entry.size() + 1;
+        FileSink::write(record);
+    }
+
+    /**
+     * Write out the buffer and resync the size with the file, which other
+     * processes may append to as well
+     */
+    void flush() override {
+        FileSink::flush();
+        if (file_.is_open()) {
+            size_ = file_.size();
+        }
+    }
+
+  private:
+    uint64_t max_bytes_;
+    std::shared_ptr<RetentionManager> retention_;
+    uint64_t size_;
+
+    uint64_t current_size() const {
+        struct stat st;
+        return ::stat(filename_.c_str(), &st) == 0
+                   ? static_cast<uint64_t>(st.st_size)
+                   : 0;
+    }
+
+    /**
+     * Rename the file and start a new one
+     * A failure throws, which degrades the sink: the record is dropped and
+     * the rotation retried after the health backoff. The file is renamed
+     * while still open, so it stays in use if that fails; one that is gone
+     * already (ENOENT) is simply replaced.
+     */
+    void rotate() {
+        if (file_.is_open()) {
+            flush();
+            std::string rotated = rotated_name();
+            if (std::rename(filename_.c_str(), rotated.c_str()) != 0 &&
+                errno != ENOENT) {
+                throw std::runtime_error("Unable to rotate " + filename_ +
+                                         ": " + std::strerror(errno));
+            }
+            file_.close();
+        }
+        if (!file_.open(filename_)) {
+            throw std::runtime_error("Unable to open log file: " + filename_);
+        }
+        size_ = current_size();
+        if (retention_) {
+            retention_->notify_rotated();
+        }
+    }
+
+    std::string rotated_name() const {
+        auto now = std::chrono::system_clock::now();
+        auto time = std::chrono::system_clock::to_time_t(now);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      now.time_since_epoch()) %
+                  1000000;
+        std::ostringstream rotated;
+        rotated << filename_ << '.'
+                << std::put_time(std::localtime(&time), "%Y%m%d-%H%M%S") << '-'
+                << std::setfill('0') << std::setw(6) << us.count();
+        return rotated.str();
+    }
+};
+
+/**
+ * Base of the sinks sending one datagram per record to a local socket
+ * Messages are encoded by the subclass as records arrive and sent when the
+ * logger flushes its sinks, or every BATCH records; on Linux a batch goes
+ * out in a single sendmmsg(2). A message too large for the socket is handed
+ * to oversized(), and dropped unless the subclass has another way to send
+ * it. After a failed send the socket is reconnected when the sink is
+ * retried, since the daemon on the other side may have restarted. Records
+ * that are not delivered are counted in health().dropped_count().
+ */
+class DatagramSink : public Sink {
+  public:
+    DatagramSink(const std::string &path, LogLevel level)
+        : Sink(level), path_(path) {
+        if (!connect()) {
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+            throw std::runtime_error("Unable to connect to " + path);
+        }
+    }
+
+    /**
+     * Sends what is pending; oversized() is no longer virtual by then, so
+     * subclasses overriding it flush in their own destructor
+     */
+    ~DatagramSink() override {
+        DatagramSink::flush();
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    void write(const LogRecord &record) override {
+        if (failed_) {
+            return; // not reconnected: checked_write() counts the record
+        }
+        pending_.emplace_back();
+        encode(record, pending_.back());
+        if (pending_.size() >= BATCH) {
+            // If this fails, checked_write() counts the record itself
+            send(pending_.size() - 1);
+        }
+    }
+
+    void flush() override { send(pending_.size()); }
+
+    bool good() const override { return !failed_; }
+
+  protected:
+    void recover() override {
+        if (failed_ && connect()) {
+            failed_ = false;
+        }
+    }
+
+    /**
+     * Build the datagram for a record
+     */
+    virtual void encode(const LogRecord &record, std::string &out) = 0;
+
+    /**
+     * Send a message too large for a datagram some other way; false if it
+     * cannot be sent
+     */
+    virtual bool oversized(const std::string &) { return false; }
+
+    /**
+     * Pass a file descriptor to the other side in an empty datagram
+     */
+    bool send_descriptor(int fd) {
+        char control[CMSG_SPACE(sizeof(int))];
+        std::memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+        ssize_t n;
+        do {
+            n = ::sendmsg(fd_, &msg, 0);
+        } while (n < 0 && errno == EINTR);
+        return n >= 0;
+    }
+
+    /**
+     * Context fields of a record, outermost first
+     * Blocks without a key, which have nothing to name a field after, are
+     * left out.
+     */
+    static std::vector<const ContextBlock *> fields(const LogRecord &record) {
+        std::vector<const ContextBlock *> result;
+        for (const ContextBlock *block = record.context.get(); block;
+             block = block->parent.get()) {
+            if (!block->key.empty()) {
+                result.push_back(block);
+            }
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    /**
+     * The message without the prefix added by the logger
+     */
+    static const std::string &message(const LogRecord &record) {
+        return record.message.empty() ? record.entry : record.message;
+    }
+
+    /**
+     * Syslog severity of a level
+     */
+    static int severity(LogLevel level) {
+        static const int SEVERITIES[] = {7, 6, 4, 3, 2};
+        return SEVERITIES[static_cast<int>(level)];
+    }
+
+  private:
+    enum : size_t { BATCH = 64 };
+
+    std::string path_;
+    int fd_ = -1;
+    bool failed_ = false;
+    std::vector<std::string> pending_;
+
+    /**
+     * Send the pending messages; if the socket fails, the first `counted`
+     * of those not sent are counted as lost
+     */
+    void send(size_t counted) {
+        size_t sent = 0;
+        while (!failed_ && sent < pending_.size()) {
+            int n = send_batch(sent);
+            if (n > 0) {
+                sent += static_cast<size_t>(n);
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EMSGSIZE) {
+                if (!oversized(pending_[sent])) {
+                    lost(1);
+                }
+                sent++;
+            } else {
+                failed_ = true;
+            }
+        }
+        if (sent < counted) {
+            lost(counted - sent);
+        }
+        pending_.clear();
+    }
+
+    bool connect() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        fd_ = cloexec_socket(AF_UNIX, SOCK_DGRAM);
+        if (fd_ < 0) {
+            return false;
+        }
+        struct sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path_.size() >= sizeof(addr.sun_path)) {
+            return false;
+        }
+        std::memcpy(addr.sun_path, path_.c_str(), path_.size() + 1);
+        return ::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr),
+                         sizeof(addr)) == 0;
+    }
+
+    /**
+     * Send pending messages from `first` on; returns how many went out, or
+     * -1 with errno set
+     */
+    int send_batch(size_t first) {
+#ifdef __linux__
+        struct mmsghdr msgs[BATCH];
+        struct iovec iovs[BATCH];
+        unsigned count = 0;
+        for (size_t i = first; i < pending_.size() && count < BATCH;
+             ++i, ++count) {
+            iovs[count].iov_base = const_cast<char *>(pending_[i].data());
+            iovs[count].iov_len = pending_[i].size();
+            std::memset(&msgs[count], 0, sizeof(msgs[count]));
+            msgs[count].msg_hdr.msg_iov = &iovs[count];
+            msgs[count].msg_hdr.msg_iovlen = 1;
+        }
+        return ::sendmmsg(fd_, msgs, count, MSG_NOSIGNAL);
+#else
+        const std::string &data = pending_[first];
+        return ::send(fd_, data.data(), data.size(), 0) < 0 ? -1 : 1;
+#endif
+    }
+};
+
+/**
+ * RFC 5424 syslog sink
+ * Sends each record to the local syslog socket as
+ *
+ *     <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID - [ctx@32473 key="value"] MSG
+ *
+ * with the logger level mapped to a syslog severity, the record time in UTC
+ * and the context fields as structured data. The message is sent as is,
+ * without the timestamp and level prefix of log file entries.
+ */
+class SyslogSink : public DatagramSink {
+  public:
+    explicit SyslogSink(const std::string &ident,
+                        const std::string &path = "/dev/log",
+                        int facility = 1, // user-level messages
+                        LogLevel level = LogLevel::DEBUG)
+        : DatagramSink(path, level),
+          header_(ident.empty() ? "-" : sd_safe(ident, 48)),
+          facility_(facility) {
+        char host[256] = "-";
+        if (::gethostname(host, sizeof(host) - 1) != 0 || !host[0]) {
+            std::strcpy(host, "-");
+        }
+        host[sizeof(host) - 1] = '\0';
+        header_ = sd_safe(host, 255) + ' ' + header_ + ' ' +
+                  std::to_string(::getpid()) + " - ";
+    }
+
+  protected:
+    void encode(const LogRecord &record, std::string &out) override {
+        out = '<' + std::to_string(facility_ * 8 + severity(record.level)) +
+              ">1 " + timestamp(record.time) + ' ' + header_;
+        auto context = fields(record);
+        if (context.empty()) {
+            out += '-';
+        } else {
+            out += "[ctx@32473";
+            for (const ContextBlock *field : context) {
+                out += ' ' + sd_safe(field->key, 32) + "=\"";
+                for (char c : field->value) {
+                    if (c == '"' || c == '\\' || c == ']') {
+                        out += '\\';
+                    }
+                    out += c;
+                }
+                out += '"';
+            }
+            out += ']';
+        }
+        out += ' ';
+        out += message(record);
+    }
+
+  private:
+    std::string header_; // "HOSTNAME APP-NAME PROCID MSGID "
+    int facility_;
+
+    static std::string timestamp(std::chrono::system_clock::time_point time) {
+        auto seconds = std::chrono::system_clock::to_time_t(time);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      time.time_since_epoch()) %
+                  1000000;
+        struct tm utc;
+        ::gmtime_r(&seconds, &utc);
+        std::ostringstream ss;
+        ss << std::put_time(&utc, "%Y-%m-%dT%H:%M:%S") << '.'
+           << std::setfill('0') << std::setw(6) << us.count() << 'Z';
+        return ss.str();
+    }
+
+    /**
+     * Printable ASCII without the characters reserved by RFC 5424 names
+     */
+    static std::string sd_safe(const std::string &name, size_t max) {
+        std::string result;
+        for (char c : name.substr(0, max)) {
+            result += c > 32 && c < 127 && c != '=' && c != ']' && c != '"'
+                          ? c
+                          : '_';
+        }
+        return result;
+    }
+};
+
+/**
+ * systemd journal sink
+ * Speaks the journal native protocol: each record is one datagram of
+ * "FIELD=value" lines, with MESSAGE, PRIORITY, SYSLOG_IDENTIFIER and the
+ * thread number, plus one field per context key, upper-cased and reduced to
+ * the characters the journal accepts. Values containing a newline use the
+ * binary form, so nothing is escaped or reformatted. On Linux an entry too
+ * large for a datagram, a long stack trace say, is written to a sealed
+ * memfd whose descriptor is sent instead, as the protocol provides.
+ */
+class JournalSink : public DatagramSink {
+  public:
+    explicit JournalSink(const std::string &ident,
+                         const std::string &path = "/run/systemd/journal/socket",
+                         LogLevel level = LogLevel::DEBUG)
+        : DatagramSink(path, level), ident_(ident) {}
+
+    // Flushed here, while oversized() still reaches this class
+    ~JournalSink() override { flush(); }
+
+  protected:
+    void encode(const LogRecord &record, std::string &out) override {
+        out.clear();
+        add_field(out, "MESSAGE", message(record));
+        add_field(out, "PRIORITY", std::to_string(severity(record.level)));
+        if (!ident_.empty()) {
+            add_field(out, "SYSLOG_IDENTIFIER", ident_);
+        }
+        add_field(out, "MINISPDLOG_THREAD", std::to_string(record.thread_id));
+        for (const ContextBlock *field : fields(record)) {
+            add_field(out, field_name(field->key), field->value);
+        }
+    }
+
+    bool oversized(const std::string &entry) override {
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+        int fd = ::memfd_create("minispdlog-journal",
+                                MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0) {
+            return false;
+        }
+        size_t done = 0;
+        while (done < entry.size()) {
+            ssize_t n = ::write(fd, entry.data() + done, entry.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        bool sent = done == entry.size() &&
+                    ::fcntl(fd, F_ADD_SEALS,
+                            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE |
+                                F_SEAL_SEAL) == 0 &&
+                    send_descriptor(fd);
+        ::close(fd);
+        return sent;
+#else
+        (void)entry;
+        return false;
+#endif
+    }
+
+  private:
+    std::string ident_;
+
+    static void add_field(std::string &out, const std::string &name,
+                          const std::string &value) {
+        out += name;
+        if (value.find('\n') == std::string::npos) {
+            out += '=';
+        } else {
+            out += '\n';
+            uint64_t size = value.size();
+            for (int i = 0; i < 8; ++i) {
+                out += static_cast<char>((size >> (8 * i)) & 0xff);
+            }
+        }
+        out += value;
+        out += '\n';
+    }
+
+    /**
+     * Journal field names are upper case letters, digits and underscores,
+     * not starting with an underscore or a digit
+     */
+    static std::string field_name(const std::string &key) {
+        std::string name;
+        for (char c : key) {
+            name += std::isalnum(static_cast<unsigned char>(c))
+                        ? static_cast<char>(
+                              std::toupper(static_cast<unsigned char>(c)))
+                        : '_';
+        }
+        if (name.empty() || name[0] == '_' ||
+            std::isdigit(static_cast<unsigned char>(name[0]))) {
+            name = "CTX_" + name;
+        }
+        return name.substr(0, 64);
+    }
+};
+#endif // MINISPDLOG_POSIX
+
+/**
+ * Sparse time index kept next to a log file
+ * Every few KB of log data the logger appends one fixed-width entry to
+ * "<log file>.idx" with the timestamp of the record that starts at that byte
+ * offset:
+ *
+ *     YYYY-MM-DD HH:MM:SS.uuuuuu 00000000000000012345
+ *
+ * Timestamps are fixed width and zero padded, so they are compared as plain
+ * strings, and any prefix of them ("2025-05-23 14:03") can be used as a
+ * bound. The reader binary-searches the index and only scans the blocks
+ * that overlap the requested range.
+ */
+class TimeIndex {
+  public:
+    static const size_t TIMESTAMP_WIDTH = 26;
+    static const size_t OFFSET_WIDTH = 20;
+    static const size_t ENTRY_SIZE = TIMESTAMP_WIDTH + OFFSET_WIDTH + 2;
+
+    static std::string index_filename(const std::string &log_filename) {
+        return log_filename + ".idx";
+    }
+
+    static std::string format_entry(const std::string &timestamp,
+                                    uint64_t offset) {
+        std::ostringstream ss;
+        ss << timestamp.substr(0, TIMESTAMP_WIDTH) << ' ' << std::setfill('0')
+           << std::setw(OFFSET_WIDTH) << offset << '\n';
+        return ss.str();
+    }
+
+    /**
+     * Find where to start reading for records at or after `from`
+     * Returns the offset of the block preceding the first block that starts
+     * at or after `from`, or 0 when there is no usable index.
+     */
+    static uint64_t find_offset(const std::string &log_filename,
+                                const std::string &from) {
+        std::ifstream index(index_filename(log_filename), std::ios::binary);
+        if (!index.is_open()) {
+            return 0;
+        }
+        index.seekg(0, std::ios::end);
+        size_t count = static_cast<size_t>(index.tellg()) / ENTRY_SIZE;
+
+        // First entry whose timestamp is >= from
+        size_t key_len =
+            from.size() < TIMESTAMP_WIDTH ? from.size() : TIMESTAMP_WIDTH;
+        size_t lo = 0, hi = count;
+        std::string entry(ENTRY_SIZE, '\0');
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (!read_entry(index, mid, entry)) {
+                return 0;
+            }
+            if (entry.compare(0, key_len, from, 0, key_len) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        // Records may start earlier inside the previous block, and
+        // timestamps taken by concurrent threads can be slightly out of
+        // order, so step back one more block.
+        size_t start = lo >= 2 ? lo - 2 : 0;
+        if (start >= count || !read_entry(index, start, entry)) {
+            return 0;
+        }
+        return std::stoull(entry.substr(TIMESTAMP_WIDTH + 1, OFFSET_WIDTH));
+    }
+
+    /**
+     * Stream the records with from <= timestamp < to
+     * Continuation lines without a timestamp follow their record. An empty
+     * `to` means up to the end of the file.
+     */
+    static void read_range(const std::string &log_filename,
+                           const std::string &from, const std::string &to,
+                           std::ostream &out) {
+        std::ifstream log(log_filename, std::ios::binary);
+        if (!log.is_open()) {
+            throw std::runtime_error("Unable to open log file: " + log_filename);
+        }
+        log.seekg(static_cast<std::streamoff>(find_offset(log_filename, from)));
+        std::string line;
+        bool in_range = false;
+        while (std::getline(log, line)) {
+            if (has_timestamp(line)) {
+                if (!to.empty() && line.compare(0, to.size(), to) >= 0) {
+                    break;
+                }
+                in_range = line.compare(0, from.size(), from) >= 0;
+            }
+            if (in_range) {
+                out << line << '\n';
+            }
+        }
+    }
+
+  private:
+    static bool read_entry(std::ifstream &index, size_t i, std::string &entry) {
+        index.seekg(static_cast<std::streamoff>(i * ENTRY_SIZE));
+        return static_cast<bool>(
+            index.read(&entry[0], static_cast<std::streamsize>(ENTRY_SIZE)));
+    }
+
+    static bool has_timestamp(const std::string &line) {
+        return line.size() >= TIMESTAMP_WIDTH && line[4] == '-' &&
+               line[10] == ' ' && line[19] == '.';
+    }
+};
+
+/**
+ * Static description of a SLOG_* call site
+ * Each macro expansion owns one, constant-initialized, so checking it costs
+ * no static-init guard. A site registers itself with CallSiteRegistry the
+ * first time it runs, picking up the rules set so far; afterwards its state
+ * is a single relaxed atomic load. The enclosing function's name is only
+ * known at run time in the lambda the macros expand to, so it is passed to
+ * state() and filled in on registration; it is null until then.
+ */
+class CallSite {
+  public:
+    enum class State { DEFAULT = 0, ENABLED, DISABLED, UNREGISTERED };
+
+    constexpr CallSite(const char *file, int line, LogLevel level,
+                       const char *format)
+        : file(file), line(line), function(nullptr), level(level),
+          format(format), state_(static_cast<int>(State::UNREGISTERED)) {}
+
+    CallSite(const CallSite &) = delete;
+    CallSite &operator=(const CallSite &) = delete;
+
+    /**
+     * DEFAULT follows the logger level, ENABLED logs regardless of it and
+     * DISABLED drops the record
+     */
+    inline State state(const char *function) {
+        int state = state_.load(std::memory_order_relaxed);
+        if (state == static_cast<int>(State::UNREGISTERED)) {
+            return register_site(function);
+        }
+        return static_cast<State>(state);
+    }
+
+    inline void set_state(State state) {
+        state_.store(static_cast<int>(state), std::memory_order_relaxed);
+    }
+
+    const char *const file;
+    const int line;
+    const char *function; // set once, under the registry mutex
+    const LogLevel level;
+    const char *const format;
+
+  private:
+    std::atomic<int> state_;
+
+    inline State register_site(const char *function);
+};
+
+/**
+ * Registry of the call sites that have run, and runtime control over them
+ * Rules select sites by file glob ("*" and "?"; a pattern without '/' is
+ * matched against the file base name) and optionally by line. They are kept
+ * and applied in order to sites registering later, the last matching rule
+ * winning; a new rule replaces one for the same glob and line. This is how
+ * a single DEBUG statement can be turned on in production without lowering
+ * the logger level. Rules from the config file
+ * (set_config_levels()) come before those set at runtime, so that a config
+ * reload neither drops nor overrides the latter.
+ */
+class CallSiteRegistry {
+  public:
+    /**
+     * Set the state of matching sites; line 0 matches every line
+     * Returns the number of sites currently registered that matched.
+     */
+    static size_t set_state(const std::string &file_glob, int line,
+                            CallSite::State state) {
+        auto &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.add_rule(
+            Rule{file_glob, line, state, false, LogLevel::DEBUG, false});
+        return registry.apply(registry.rules.back());
+    }
+
+    /**
+     * Give matching files their own level
+     * Sites at or above `level` are enabled and the others disabled,
+     * whatever the logger level. Returns the number of sites matched.
+     */
+    static size_t set_level(const std::string &file_glob, LogLevel level) {
+        auto &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.add_rule(
+            Rule{file_glob, 0, CallSite::State::DEFAULT, true, level, false});
+        return registry.apply(registry.rules.back());
+    }
+
+    /**
+     * Replace the file levels that came from the config file
+     * Rules set through set_state() and set_level() are kept, and still
+     * win over the new ones.
+     */
+    static void set_config_levels(
+        const std::vector<std::pair<std::string, LogLevel>> &levels) {
+        auto &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::vector<Rule> rules;
+        for (const auto &level : levels) {
+            rules.push_back(Rule{level.first, 0, CallSite::State::DEFAULT,
+                                 true, level.second, true});
+        }
+        for (const auto &rule : registry.rules) {
+            if (!rule.from_config) {
+                rules.push_back(rule);
+            }
+        }
+        registry.rules.swap(rules);
+        for (CallSite *site : registry.sites) {
+            site->set_state(registry.state_for(*site));
+        }
+    }
+
+    /**
+     * Forget all rules and put every site back to DEFAULT
+     */
+    static void reset() {
+        auto &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.rules.clear();
+        for (CallSite *site : registry.sites) {
+            site->set_state(CallSite::State::DEFAULT);
+        }
+    }
+
+    static std::vector<const CallSite *> sites() {
+        auto &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        return std::vector<const CallSite *>(registry.sites.begin(),
+                                             registry.sites.end());
+    }
+
+    static CallSite::State add(CallSite &site, const char *function) {
+        auto &registry = instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        CallSite::State state = registry.state_for(site);
+        // Two threads may race to register the same site
+        if (std::find(registry.sites.begin(), registry.sites.end(), &site) ==
+            registry.sites.end()) {
+            site.function = function;
+            registry.sites.push_back(&site);
+        }
+        site.set_state(state);
+        return state;
+    }
+
+    /**
+     * Glob matching with "*" and "?"
+     */
+    static bool glob_match(const char *pattern, const char *text) {
+        const char *star = nullptr;
+        const char *resume = nullptr;
+        while (*text) {
+            if (*pattern == '*') {
+                star = pattern++;
+                resume = text;
+            } else if (*pattern == '?' || *pattern == *text) {
+                ++pattern;
+                ++text;
+            } else if (star) {
+                pattern = star + 1;
+                text = ++resume;
+            } else {
+                return false;
+            }
+        }
+        while (*pattern == '*') {
+            ++pattern;
+        }
+        return *pattern == '\0';
+    }
+
+  private:
+    struct Rule {
+        std::string file_glob;
+        int line;
+        CallSite::State state;
+        bool by_level;
+        LogLevel level;
+        bool from_config;
+
+        CallSite::State state_for(const CallSite &site) const {
+            if (!by_level) {
+                return state;
+            }
+            return site.level >= level ? CallSite::State::ENABLED
+                                       : CallSite::State::DISABLED;
+        }
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<CallSite *> sites;
+        std::vector<Rule> rules;
+
+        CallSite::State state_for(const CallSite &site) const {
+            CallSite::State state = CallSite::State::DEFAULT;
+            for (const auto &rule : rules) {
+                if (matches(rule, site)) {
+                    state = rule.state_for(site);
+                }
+            }
+            return state;
+        }
+
+        /**
+         * Append a runtime rule, dropping the one it supersedes
+         * A rule for the same glob and line selects the same sites and
+         * loses to the new one anyway, so repeated commands do not grow
+         * the list.
+         */
+        void add_rule(Rule rule) {
+            rules.erase(std::remove_if(rules.begin(), rules.end(),
+                                       [&rule](const Rule &old) {
+                                           return !old.from_config &&
+                                                  old.line == rule.line &&
+                                                  old.file_glob ==
+                                                      rule.file_glob;
+                                       }),
+                        rules.end());
+            rules.push_back(std::move(rule));
+        }
+
+        size_t apply(const Rule &rule) {
+            size_t matched = 0;
+            for (CallSite *site : sites) {
+                if (matches(rule, *site)) {
+                    site->set_state(rule.state_for(*site));
+                    matched++;
+                }
+            }
+            return matched;
+        }
+    };
+
+    static Registry &instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    static bool matches(const Rule &rule, const CallSite &site) {
+        if (rule.line != 0 && rule.line != site.line) {
+            return false;
+        }
+        const char *file = site.file;
+        if (rule.file_glob.find('/') == std::string::npos) {
+            const char *slash = std::strrchr(file, '/');
+            file = slash ? slash + 1 : file;
+        }
+        return glob_match(rule.file_glob.c_str(), file);
+    }
+};
+
+inline CallSite::State CallSite::register_site(const char *function) {
+    return CallSiteRegistry::add(*this, function);
+}
+
+/**
+ * What an async logger does with a record when its queue is full
+ * BLOCK makes the producer wait for room, DROP discards the record and
+ * counts it, SPILL appends it to the logger's spill file (see SpillFile),
+ * dropping it only if that is missing or full. Durable records are never
+ * dropped: they wait instead.
+ */
+enum class OverflowPolicy {
+    BLOCK = 0,
+    DROP,
+    SPILL,
+};
+
+#ifdef MINISPDLOG_POSIX
+/**
+ * Preallocated overflow file for the async queue
+ * Records that do not fit in memory are appended as frames of a fixed
+ * header followed by the message and the context key/value pairs, outermost
+ * first, each as two 32-bit sizes and the two strings; they are read back
+ * in order by the worker, with the context stack rebuilt. The file is used
+ * as a ring: a frame that does not fit before the end goes at the start
+ * once the frames there have been read back, so `max_bytes` bounds the
+ * backlog, not the traffic. The file only lives as long as the logger, so
+ * the header is in native byte order.
+ *
+ * Appending is split so that no disk I/O happens under the logger's queue
+ * mutex: reserve() picks the place of the frame and release() forgets read
+ * frames, both cheap and called with the queue mutex held so that the
+ * pending count stays consistent with the queue; write() and read() do the
+ * I/O without it. A single thread reads. The bookkeeping has its own mutex,
+ * never held during I/O.
+ */
+class SpillFile {
+  public:
+    SpillFile(const std::string &filename, size_t max_bytes)
+        : filename_(filename), max_bytes_(max_bytes) {
+        fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     0600);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open spill file: " + filename);
+        }
+#ifdef __linux__
+        int rc = ::posix_fallocate(fd_, 0, static_cast<off_t>(max_bytes));
+#else
+        int rc = ::ftruncate(fd_, static_cast<off_t>(max_bytes));
+#endif
+        if (rc != 0) {
+            ::close(fd_);
+            ::unlink(filename.c_str());
+            throw std::runtime_error("Cannot preallocate spill file: " +
+                                     filename);
+        }
+    }
+
+    ~SpillFile() {
+        ::close(fd_);
+        ::unlink(filename_.c_str());
+    }
+
+    SpillFile(const SpillFile &) = delete;
+    SpillFile &operator=(const SpillFile &) = delete;
+
+    /**
+     * Number of records reserved and not released yet
+     */
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frames_.size();
+    }
+
+    /**
+     * Sequence number of the oldest pending record, or the largest value
+     * if there is none
+     */
+    uint64_t oldest() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frames_.empty() ? UINT64_MAX : frames_.front().seq;
+    }
+
+    /**
+     * Whether the oldest pending record has been written and can be read
+     */
+    bool readable() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !frames_.empty() && frames_.front().written;
+    }
+
+    /**
+     * Reserve room for a record with the given sequence number; false if
+     * the file is full
+     * The caller then passes the returned offset to write().
+     */
+    bool reserve(const LogRecord &record, uint64_t seq, size_t &offset) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t size = frame_size(record);
+        if (!room(size, offset)) {
+            return false;
+        }
+        frames_.push_back(Slot{offset, size, seq, false, nullptr});
+        write_ = offset + size;
+        return true;
+    }
+
+    /**
+     * Write a reserved record
+     * If the file cannot be written, the record is kept in memory instead
+     * and read() returns it all the same.
+     */
+    void write(size_t offset, const LogRecord &record, uint64_t seq) {
+        std::string data = encode(record, seq);
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = ::pwrite(fd_, data.data() + done, data.size() - done,
+                                 static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = frames_.rbegin(); it != frames_.rend(); ++it) {
+            if (it->offset == offset) {
+                if (done < data.size()) {
+                    it->record.reset(new LogRecord(record));
+                    it->record->seq = seq;
+                }
+                it->written = true;
+                break;
+            }
+        }
+    }
+
+    /**
+     * Read back up to `max` of the oldest written records, in order
+     * They stay pending until release(). Returns how many frames were
+     * consumed; those that could not be read are counted in `lost`, along
+     * with the largest of their sequence numbers.
+     */
+    size_t read(std::vector<LogRecord> &records, size_t max, size_t &lost,
+                uint64_t &lost_seq) {
+        std::vector<Slot> slots;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &slot : frames_) {
+                if (!slot.written || slots.size() == max) {
+                    break;
+                }
+                slots.push_back(Slot{slot.offset, slot.size, slot.seq, true,
+                                     std::move(slot.record)});
+            }
+        }
+        lost = 0;
+        size_t buffer_start = 0, buffer_end = 0;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            Slot &slot = slots[i];
+            if (slot.record) {
+                records.push_back(std::move(*slot.record));
+                continue;
+            }
+            if (slot.offset < buffer_start ||
+                slot.offset + slot.size > buffer_end) {
+                // Read the run of adjacent frames starting here at once
+                buffer_end = slot.offset + slot.size;
+                for (size_t j = i + 1; j < slots.size() && !slots[j].record &&
+                                       slots[j].offset == buffer_end &&
+                                       buffer_end - slot.offset < READ_AHEAD;
+                     ++j) {
+                    buffer_end += slots[j].size;
+                }
+                buffer_start = slot.offset;
+                if (!fill(buffer_start, buffer_end - buffer_start)) {
+                    buffer_end = buffer_start;
+                    lost++;
+                    lost_seq = slot.seq;
+                    continue;
+                }
+            }
+            records.emplace_back();
+            decode(buffer_.data() + (slot.offset - buffer_start),
+                   records.back());
+        }
+        return slots.size();
+    }
 
-enum class LogLevel {
-    DEBUG = 0,
-    INFO,
-    WARN,
-    ERROR,
-    CRITICAL,
+    /**
+     * Forget the `count` oldest records, once read
+     */
+    void release(size_t count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_.erase(frames_.begin(), frames_.begin() + count);
+    }
+
+  private:
+    struct Frame {
+        uint32_t message_size;
+        uint32_t context_size;
+        uint64_t seq;
+        int64_t time_ns;
+        uint64_t thread_id;
+        uint32_t level;
+        uint32_t durable;
+        uint64_t span_name; // pointer, valid since the file is per process
+        int64_t span_start_us;
+        int64_t span_duration_us;
+    };
+
+    struct Slot {
+        size_t offset;
+        size_t size;
+        uint64_t seq;
+        bool written;
+        std::unique_ptr<LogRecord> record; // set if the write failed
+    };
+
+    enum : size_t { READ_AHEAD = 256 * 1024 };
+
+    std::string filename_;
+    size_t max_bytes_;
+    int fd_;
+    mutable std::mutex mutex_;
+    std::deque<Slot> frames_; // pending frames, oldest first
+    size_t write_ = 0;        // end of the newest frame
+    std::vector<char> buffer_; // used by the reading thread only
+
+    static size_t context_size(const LogRecord &record) {
+        size_t size = 0;
+        for (const ContextBlock *block = record.context.get(); block;
+             block = block->parent.get()) {
+            size += 2 * sizeof(uint32_t) + block->key.size() +
+                    block->value.size();
+        }
+        return size;
+    }
+
+    static size_t frame_size(const LogRecord &record) {
+        return sizeof(Frame) + record.message.size() + context_size(record);
+    }
+
+    static void add_context(std::string &data, const ContextBlock *block) {
+        if (!block) {
+            return;
+        }
+        add_context(data, block->parent.get());
+        uint32_t sizes[2] = {static_cast<uint32_t>(block->key.size()),
+                             static_cast<uint32_t>(block->value.size())};
+        data.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+        data += block->key;
+        data += block->value;
+    }
+
+    static std::string encode(const LogRecord &record, uint64_t seq) {
+        Frame frame;
+        frame.message_size = static_cast<uint32_t>(record.message.size());
+        frame.context_size = static_cast<uint32_t>(context_size(record));
+        frame.seq = seq;
+        frame.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            record.time.time_since_epoch())
+                            .count();
+        frame.thread_id = record.thread_id;
+        frame.level = static_cast<uint32_t>(record.level);
+        frame.durable = record.durable;
+        frame.span_name = reinterpret_cast<uintptr_t>(record.span_name);
+        frame.span_start_us = record.span_start_us;
+        frame.span_duration_us = record.span_duration_us;
+        std::string data(reinterpret_cast<const char *>(&frame), sizeof(frame));
+        data += record.message;
+        add_context(data, record.context.get());
+        return data;
+    }
+
+    static void decode(const char *data, LogRecord &record) {
+        Frame frame;
+        std::memcpy(&frame, data, sizeof(Frame));
+        data += sizeof(Frame);
+        record = LogRecord(static_cast<LogLevel>(frame.level), std::string());
+        record.message.assign(data, frame.message_size);
+        const char *context = data + frame.message_size;
+        const char *end = context + frame.context_size;
+        while (context < end) {
+            uint32_t sizes[2];
+            std::memcpy(sizes, context, sizeof(sizes));
+            context += sizeof(sizes);
+            std::string key(context, sizes[0]);
+            record.context = LogContext::make_block(
+                std::move(record.context), key,
+                std::string(context + sizes[0], sizes[1]));
+            context += sizes[0] + sizes[1];
+        }
+        record.seq = frame.seq;
+        record.time = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::nanoseconds(frame.time_ns)));
+        record.thread_id = static_cast<size_t>(frame.thread_id);
+        record.durable = frame.durable != 0;
+        record.span_name =
+            reinterpret_cast<const char *>(static_cast<uintptr_t>(frame.span_name));
+        record.span_start_us = frame.span_start_us;
+        record.span_duration_us = frame.span_duration_us;
+    }
+
+    /**
+     * Find where a frame of `size` bytes goes: after the newest frame, or
+     * at the start of the file if the oldest one is far enough from it
+     */
+    bool room(size_t size, size_t &offset) const {
+        if (frames_.empty()) {
+            offset = 0;
+            return size <= max_bytes_;
+        }
+        size_t head = frames_.front().offset;
+        if (write_ > head) {
+            offset = write_ + size <= max_bytes_ ? write_ : 0;
+            return offset == write_ || size <= head;
+        }
+        offset = write_;
+        return write_ + size <= head;
+    }
+
+    /**
+     * Read [offset, offset + size) into the read buffer
+     */
+    bool fill(size_t offset, size_t size) {
+        buffer_.resize(std::max(buffer_.size(), size));
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::pread(fd_, buffer_.data() + done, size - done,
+                                static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+};
+#endif // MINISPDLOG_POSIX
+
+/**
+ * Backend thread writing records to a group of sinks
+ * Used by Logger::enable_sink_workers(): the logger formats each record
+ * once and hands the same shared copy to every worker, whose thread writes
+ * it to its own sinks, so a slow sink only holds back the sinks sharing its
+ * thread. The sinks are flushed after each batch taken from the queue.
+ *
+ * The queue holds at most `capacity` records (0 for no limit); records
+ * pushed beyond that are dropped for this worker's sinks and counted, so a
+ * stalled sink costs bounded memory. Sinks are added and removed through
+ * the same queue, so the change takes effect at a precise point of the
+ * record stream without waiting for a write in progress.
+ */
+class SinkWorker {
+  public:
+    explicit SinkWorker(size_t capacity = 0)
+        : capacity_(capacity), thread_(&SinkWorker::run, this) {}
+
+    ~SinkWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    SinkWorker(const SinkWorker &) = delete;
+    SinkWorker &operator=(const SinkWorker &) = delete;
+
+    void add(std::shared_ptr<Sink> sink) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assigned_.push_back(sink.get());
+        queue_.push_back(Item{nullptr, std::move(sink), true});
+        pushed_++;
+        cv_.notify_one();
+    }
+
+    /**
+     * Flush and let go of a sink, after the records pushed so far; false
+     * if it is not served here
+     */
+    bool remove(const std::shared_ptr<Sink> &sink) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find(assigned_.begin(), assigned_.end(), sink.get());
+        if (it == assigned_.end()) {
+            return false;
+        }
+        assigned_.erase(it);
+        queue_.push_back(Item{nullptr, sink, false});
+        pushed_++;
+        cv_.notify_one();
+        return true;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return assigned_.size();
+    }
+
+    void push(std::shared_ptr<const LogRecord> record) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (capacity_ && queued_ >= capacity_) {
+            dropped_++;
+            return;
+        }
+        queue_.push_back(Item{std::move(record), nullptr, false});
+        queued_++;
+        pushed_++;
+        cv_.notify_one();
+    }
+
+    /**
+     * Number of records waiting, and dropped because the queue was full
+     */
+    size_t queued() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queued_;
+    }
+
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+    /**
+     * Wait until the records pushed so far are written and flushed
+     * Returns false if `deadline` passes first.
+     */
+    bool wait_idle(std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t target = pushed_;
+        auto idle = [this, target] { return done_ >= target; };
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            idle_cv_.wait(lock, idle);
+            return true;
+        }
+        return idle_cv_.wait_until(lock, deadline, idle);
+    }
+
+  private:
+    // A record to write, or a sink to add or remove
+    struct Item {
+        std::shared_ptr<const LogRecord> record;
+        std::shared_ptr<Sink> sink;
+        bool add;
+    };
+
+    size_t capacity_;
+    std::mutex mutex_; // guards the queue, the counters and assigned_
+    std::condition_variable cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Item> queue_;
+    size_t queued_ = 0; // records in queue_
+    uint64_t pushed_ = 0;
+    uint64_t done_ = 0;
+    uint64_t dropped_ = 0;
+    bool stop_ = false;
+    std::vector<const Sink *> assigned_; // sinks_ once the queue is done
+    std::vector<std::shared_ptr<Sink>> sinks_; // used by the thread only
+    std::thread thread_;
+
+    void run() {
+        std::deque<Item> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return !queue_.empty() || stop_; });
+            if (queue_.empty()) {
+                return;
+            }
+            batch.swap(queue_);
+            queued_ = 0;
+            uint64_t done = done_ + batch.size();
+            lock.unlock();
+            for (auto &item : batch) {
+                if (item.record) {
+                    write(*item.record);
+                } else if (item.add) {
+                    sinks_.push_back(std::move(item.sink));
+                } else {
+                    auto it = std::find(sinks_.begin(), sinks_.end(), item.sink);
+                    if (it != sinks_.end()) {
+                        (*it)->checked_flush();
+                        sinks_.erase(it);
+                    }
+                }
+            }
+            for (auto &sink : sinks_) {
+                sink->checked_flush();
+            }
+            batch.clear();
+            lock.lock();
+            done_ = done;
+            idle_cv_.notify_all();
+        }
+    }
+
+    void write(const LogRecord &record) {
+        for (auto &sink : sinks_) {
+            if (record.span_name ? sink->accepts_spans()
+                                 : sink->should_write(record.level)) {
+                sink->checked_write(record);
+            }
+        }
+    }
+};
+
+class Logger;
+
+/**
+ * Completion handle for a record logged with Logger::log_durable()
+ * wait() returns once the record has been written and synced to stable
+ * storage, and reports whether the sync succeeded. A ticket must not outlive
+ * its logger.
+ */
+class DurableTicket {
+  public:
+    DurableTicket(Logger *logger, uint64_t seq) : logger_(logger), seq_(seq) {}
+
+    inline bool wait() const;
+    inline bool wait_for(std::chrono::milliseconds timeout) const;
+
+  private:
+    Logger *logger_;
+    uint64_t seq_;
 };
 
 class Logger {
@@ -48,12 +3214,15 @@ class Logger {
     /**
      * Constructor
      * This constructor initializes the logger with a specified filename,
-     * minimum log level, and whether to use asynchronous mode.
+     * minimum log level, and whether to use asynchronous mode. An empty
+     * filename creates a logger that only writes to its sinks.
      */
     explicit Logger(const std::string &filename,
                     LogLevel min_level = LogLevel::DEBUG,
                     bool async_mode = false)
-        : min_level_(min_level), async_mode_(async_mode), stop_thread_(false) {
+        : min_level_(min_level), threshold_(min_level), async_mode_(async_mode),
+          reopen_generation_(reopen_signal_generation().load()),
+          stop_thread_(false) {
         initialize_log_file(filename);
         if (async_mode_) {
             worker_thread_ = std::thread(&Logger::worker_function, this);
@@ -72,19 +3241,517 @@ class Logger {
             if (worker_thread_.joinable()) {
                 worker_thread_.join();
             }
+            sink_worker_count_ = 0;
+            sink_workers_.clear(); // drains their queues
+        }
+        if (flusher_thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(buffer_mutex_);
+                stop_flusher_ = true;
+            }
+            buffer_cv_.notify_all();
+            flusher_thread_.join();
+            std::lock_guard<std::mutex> file_lock(mutex_);
+            drain_buffer();
         }
 
         if (log_file_.is_open()) {
             log_file_.close();
         }
+#ifdef MINISPDLOG_POSIX
+        if (sync_fd_ >= 0) {
+            ::close(sync_fd_);
+        }
+#endif
+    }
+
+    /**
+     * Enable the sidecar time index
+     * An entry is appended to "<log file>.idx" each time at least
+     * `block_bytes` of log data have been written since the previous one.
+     * See TimeIndex for the format and the reader side.
+     */
+    void enable_time_index(size_t block_bytes = 64 * 1024) {
+        if (filename_.empty()) {
+            throw std::runtime_error("Time index requires a log file");
+        }
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        index_file_.open(TimeIndex::index_filename(filename_), std::ios::app);
+        if (!index_file_.is_open()) {
+            throw std::runtime_error("Unable to open index file: " +
+                                     TimeIndex::index_filename(filename_));
+        }
+        index_block_bytes_ = std::max<size_t>(block_bytes, 1);
+        next_index_offset_ = file_offset_;
+    }
+
+    /**
+     * Enable durable logging (POSIX only)
+     * Records logged with log_durable() are acknowledged through their
+     * ticket only once they are on stable storage. In async mode the worker
+     * group-commits: after writing a durable record it keeps writing for up
+     * to `max_delay`, then issues a single fdatasync for everything written
+     * so far and completes all the tickets of that group. In sync mode every
+     * durable record is synced before log_durable() returns.
+     */
+    void enable_durable_mode(
+        std::chrono::microseconds max_delay = std::chrono::milliseconds(2)) {
+#ifdef MINISPDLOG_POSIX
+        int fd = open_sync_fd(filename_);
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        if (sync_fd_ >= 0) {
+            ::close(sync_fd_);
+        }
+        sync_fd_ = fd;
+        commit_delay_ = max_delay;
+#else
+        (void)max_delay;
+        throw std::runtime_error("Durable mode requires a POSIX system");
+#endif
+    }
+
+    /**
+     * Buffer the log file writes of a sync logger
+     * Producers append entries to an in-memory buffer under a short lock
+     * instead of writing and flushing the file themselves. A background
+     * thread swaps in a spare buffer and writes out the full one every
+     * `interval`, or once it holds `buffer_bytes`; at most that much is
+     * lost in a crash. Sinks are still written by the producer, durable
+     * records are written through, after the buffer. Can only be called
+     * once.
+     */
+    void enable_buffered_writes(
+        std::chrono::milliseconds interval = std::chrono::milliseconds(100),
+        size_t buffer_bytes = 256 * 1024) {
+        if (async_mode_) {
+            throw std::runtime_error("Buffered writes require sync mode");
+        }
+        if (filename_.empty()) {
+            throw std::runtime_error("Buffered writes require a log file");
+        }
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        if (buffered_) {
+            throw std::runtime_error("Buffered writes already enabled");
+        }
+        flush_interval_ = interval;
+        buffer_bytes_ = std::max<size_t>(buffer_bytes, 1024);
+        active_buffer_.reserve(2 * buffer_bytes_);
+        spare_buffer_.reserve(2 * buffer_bytes_);
+        buffered_ = true;
+        flusher_thread_ = std::thread(&Logger::flusher_function, this);
+    }
+
+    /**
+     * Log a message and get a ticket that completes once it is durable
+     * Requires enable_durable_mode(). Records below the logger level are
+     * not written, and their tickets complete immediately.
+     */
+    DurableTicket log_durable(LogLevel level, const std::string &message) {
+        return DurableTicket(this, write_log(level, message, true));
+    }
+
+    template <typename... Args>
+    DurableTicket log_durable(LogLevel level, const std::string &format,
+                              Args... args) {
+        if (level < min_level_.load(std::memory_order_relaxed))
+            return DurableTicket(this, 0);
+        std::ostringstream ss;
+        format_message(ss, format, args...);
+        return DurableTicket(this, write_log(level, ss.str(), true));
+    }
+
+    /**
+     * Wait until the record with the given sequence number is durable
+     * Returns false on timeout, or if a sync has failed: after a failed
+     * fdatasync the kernel may have dropped dirty pages, so no later record
+     * is reported as durable either.
+     */
+    bool wait_durable(uint64_t seq,
+                      std::chrono::milliseconds timeout =
+                          std::chrono::milliseconds::max()) {
+        std::unique_lock<std::mutex> lock(durable_mutex_);
+        auto done = [this, seq] { return durable_seq_ >= seq || sync_failed_; };
+        if (timeout == std::chrono::milliseconds::max()) {
+            durable_cv_.wait(lock, done);
+        } else if (!durable_cv_.wait_for(lock, timeout, done)) {
+            return false;
+        }
+        return !sync_failed_;
+    }
+
+    /**
+     * Drop written log file pages from the page cache
+     * See LogFile::drop_cache(); 0, the default, keeps them.
+     */
+    void drop_file_cache(size_t bytes) {
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        log_file_.drop_cache(bytes);
+    }
+
+    /**
+     * Allocate the log file ahead in extents of `bytes` (Linux only)
+     * See LogFile::preallocate(); 0, the default, turns it off.
+     */
+    void preallocate_file(size_t bytes) {
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        log_file_.preallocate(bytes);
+    }
+
+    /**
+     * Reopen the log file
+     * Meant for external rotation (logrotate): after the file has been
+     * renamed, the next records go to a new file with the original name. The
+     * new file is opened before taking the file lock, and the old one is
+     * closed after releasing it, so writers only wait for the swap. When the
+     * new file is empty the time index is restarted too.
+     */
+    void reopen() {
+        if (filename_.empty()) {
+            return;
+        }
+        LogFile fresh;
+        if (!fresh.open(filename_)) {
+            throw std::runtime_error("Unable to reopen log file: " + filename_);
+        }
+        uint64_t size = current_file_size(filename_);
+        std::ofstream fresh_index;
+        if (index_block_bytes_) {
+            fresh_index.open(TimeIndex::index_filename(filename_),
+                             size == 0 ? std::ios::trunc : std::ios::app);
+        }
+#ifdef MINISPDLOG_POSIX
+        int fresh_sync_fd = sync_fd_ >= 0 ? open_sync_fd(filename_) : -1;
+#endif
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        drain_buffer(); // buffered entries were logged before the rotation
+#ifdef MINISPDLOG_POSIX
+        if (sync_fd_ >= 0) {
+            // Records still waiting for a group commit live in the old file
+            sync_file();
+            ::close(sync_fd_);
+            sync_fd_ = fresh_sync_fd;
+        }
+#endif
+        log_file_.swap(fresh);
+        file_offset_ = size;
+        if (fresh_index.is_open()) {
+            index_file_.swap(fresh_index);
+            next_index_offset_ = file_offset_;
+        }
+    }
+
+#ifdef MINISPDLOG_POSIX
+    /**
+     * Install a SIGHUP handler that makes every logger reopen its file
+     * The handler only bumps an atomic counter; each logger notices the
+     * change before its next write (between batches in async mode) and calls
+     * reopen() from there.
+     */
+    static void install_sighup_handler() {
+        reopen_signal_generation(); // initialized outside the handler
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = &Logger::handle_reopen_signal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        if (::sigaction(SIGHUP, &action, nullptr) != 0) {
+            throw std::runtime_error("Unable to install SIGHUP handler");
+        }
+    }
+#endif
+
+    // Delete copy constructor and assignment operator
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    inline void set_level(LogLevel level) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        min_level_.store(level, std::memory_order_relaxed);
+        threshold_.store(std::max(level, shed_level_),
+                         std::memory_order_relaxed);
+    }
+
+    inline LogLevel level() const {
+        return min_level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Counters for monitoring
+     * `written` counts records handed to the file and sinks, `queued` the
+     * records waiting for the async worker in memory and `spilled` those
+     * waiting in the spill file, `dropped` those discarded because the
+     * queue was full and `shed` those discarded by load shedding.
+     * `degraded` counts the outputs, log file included, that are failing
+     * (see OutputHealth). `effective_level` is the level raised by load
+     * shedding. With sink workers, `sink_queued` counts the records waiting
+     * in their queues and `sink_dropped` those their full queues turned
+     * away; such records still reached the log file and the other workers'
+     * sinks.
+     */
+    struct Stats {
+        LogLevel level;
+        LogLevel effective_level;
+        uint64_t written;
+        size_t queued;
+        size_t spilled;
+        size_t capacity;
+        uint64_t dropped;
+        uint64_t shed;
+        size_t sinks;
+        size_t degraded;
+        size_t sink_queued;
+        uint64_t sink_dropped;
+    };
+
+    Stats stats() {
+        Stats result;
+        result.level = level();
+        result.written = records_written_.load(std::memory_order_relaxed);
+        result.shed = shed_.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            result.effective_level = threshold_.load(std::memory_order_relaxed);
+            result.queued = log_queue_.size() + priority_queue_.size();
+            result.spilled = spilled();
+            result.capacity = queue_capacity_;
+            result.dropped = dropped_;
+        }
+        result.sinks = sink_count_.load(std::memory_order_relaxed);
+        result.sink_queued = 0;
+        result.sink_dropped = 0;
+        for (SinkWorker *worker : workers()) {
+            result.sink_queued += worker->queued();
+            result.sink_dropped += worker->dropped();
+        }
+        result.degraded = file_health_.degraded() ? 1 : 0;
+        auto sinks = std::atomic_load(&sink_snapshot_);
+        for (const auto &sink : *sinks) {
+            result.degraded += sink->health().degraded() ? 1 : 0;
+        }
+        return result;
+    }
+
+    /**
+     * Wait until every record logged before the call has been written
+     * In async mode this waits for the worker to reach the sequence number
+     * of the last record enqueued so far in each lane, without stopping it;
+     * records logged meanwhile by other threads are not waited for. The file
+     * and the sinks are flushed afterwards; sink workers are waited for until
+     * they have flushed theirs. Returns false if the timeout expires first.
+     */
+    bool flush(std::chrono::milliseconds timeout =
+                   std::chrono::milliseconds::max()) {
+        auto deadline = timeout == std::chrono::milliseconds::max()
+                            ? std::chrono::steady_clock::time_point::max()
+                            : std::chrono::steady_clock::now() + timeout;
+        if (async_mode_) {
+            uint64_t target, priority_target;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                target = normal_seq_;
+                priority_target = priority_seq_;
+            }
+            auto written = [this, target, priority_target] {
+                return written_seq_ >= target &&
+                       priority_written_seq_ >= priority_target;
+            };
+            std::unique_lock<std::mutex> flush_lock(flush_mutex_);
+            flush_waiters_++;
+            bool done = true;
+            if (timeout == std::chrono::milliseconds::max()) {
+                flush_cv_.wait(flush_lock, written);
+            } else {
+                done = flush_cv_.wait_for(flush_lock, timeout, written);
+            }
+            flush_waiters_--;
+            flush_lock.unlock();
+            if (!done) {
+                return false;
+            }
+            for (SinkWorker *worker : workers()) {
+                if (!worker->wait_idle(deadline)) {
+                    return false;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        drain_buffer();
+        flush_sinks();
+        return true;
+    }
+
+    /**
+     * Add an output sink
+     * Records accepted by the logger are written to the log file and then to
+     * every sink whose own level lets them through.
+     */
+    void add_sink(std::shared_ptr<Sink> sink) {
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        if (sink->accepts_spans()) {
+            spans_enabled_ = true;
+        }
+        if (!sink_workers_.empty()) {
+            assign_sink(sink);
+        }
+        sinks_.push_back(std::move(sink));
+        sinks_changed();
+    }
+
+    /**
+     * Write to the sinks from `threads` backend threads (async mode only)
+     * Each sink is given to the thread with the fewest sinks, now and as
+     * sinks are added, and each thread has its own queue: the worker writes
+     * the log file and hands every record, formatted once and shared, to
+     * all the queues. A slow sink then only delays the sinks on its thread.
+     * A queue holds up to `queue_capacity` records (0 for no limit); when
+     * it is full the record is dropped for that thread's sinks only, and
+     * counted in stats().sink_dropped. Can only be called once.
+     */
+    void enable_sink_workers(size_t threads, size_t queue_capacity = 8192) {
+        if (!async_mode_) {
+            throw std::runtime_error("Sink workers require async mode");
+        }
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        if (!sink_workers_.empty()) {
+            throw std::runtime_error("Sink workers already enabled");
+        }
+        if (!threads) {
+            return;
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            sink_workers_.emplace_back(new SinkWorker(queue_capacity));
+        }
+        for (const auto &sink : sinks_) {
+            sink->checked_flush();
+            assign_sink(sink);
+        }
+        sink_worker_count_.store(threads, std::memory_order_release);
+    }
+
+    /**
+     * Swap a set of sinks for another in one step
+     * Records are written either to all the old sinks or to all the new
+     * ones; the old sinks are flushed before being let go. Sinks not in
+     * `removed` are kept. With sink workers the swap is queued behind the
+     * records already handed to them, and the call waits up to `timeout`
+     * for it to be done; it returns false if a stalled sink keeps a worker
+     * busy past that, the swap then completing in the background.
+     */
+    bool replace_sinks(const std::vector<std::shared_ptr<Sink>> &removed,
+                       const std::vector<std::shared_ptr<Sink>> &added,
+                       std::chrono::milliseconds timeout =
+                           std::chrono::seconds(5)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        {
+            std::lock_guard<std::mutex> file_lock(mutex_);
+            swap_sinks(removed, added);
+        }
+        for (SinkWorker *worker : workers()) {
+            if (!worker->wait_idle(deadline)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Shed load when the async queue backs up
+     * From `high` queued records on, DEBUG records are discarded, and INFO
+     * ones too from twice that; repeated messages below ERROR are sampled,
+     * keeping one out of `sample_every`. Normal logging resumes once the
+     * queue is down to `low`. Each change is logged as a WARN line and
+     * stats().shed counts the records discarded. A `high` of 0 disables it.
+     */
+    void enable_load_shedding(size_t high, size_t low,
+                              size_t sample_every = 10) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        shed_high_ = high;
+        shed_low_ = std::min(low, high);
+        shed_sample_ = std::max<size_t>(sample_every, 1);
+        if (!shed_high_ && shed_step_) {
+            LogRecord notice = set_shed_step(0, log_queue_.size());
+            notice.seq = normal_seq_ = ++enqueued_seq_;
+            log_queue_.push(std::move(notice));
+        }
+    }
+
+    /**
+     * Bound the async queue
+     * A capacity of 0, the default, leaves it unbounded. Can be changed at
+     * any time; records already queued are kept.
+     */
+    void set_queue_capacity(size_t capacity,
+                            OverflowPolicy policy = OverflowPolicy::BLOCK) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue_capacity_ = capacity;
+        overflow_policy_ = policy;
+        space_cv_.notify_all();
+    }
+
+    /**
+     * Set up the spill file used by OverflowPolicy::SPILL (POSIX only)
+     * `max_bytes` are preallocated at `filename`, which is removed when the
+     * logger goes away. While records wait in the file, later ones are
+     * appended behind them whatever the policy, so they are written in
+     * order; the worker reads them back once the queue is empty. Should be
+     * called before logging starts.
+     */
+    void enable_spill(const std::string &filename,
+                      size_t max_bytes = 64 * 1024 * 1024) {
+#ifdef MINISPDLOG_POSIX
+        std::unique_ptr<SpillFile> spill(new SpillFile(filename, max_bytes));
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (spill_ && spill_->pending()) {
+            throw std::runtime_error("Spill file in use: " + filename);
+        }
+        spill_ = std::move(spill);
+#else
+        (void)filename;
+        (void)max_bytes;
+        throw std::runtime_error("Spill file requires a POSIX system");
+#endif
+    }
+
+    /**
+     * Send records at `level` and above through a separate queue
+     * The worker always drains that queue first, and it is never bounded,
+     * shed or spilled, so an error is not stuck behind a backlog of debug
+     * lines. A record written ahead of older ones still waiting gets an
+     * "order=early" context entry; its timestamp gives its real place.
+     * Durable records and spans keep to the normal queue. With
+     * `sync_critical`, CRITICAL records are written and flushed by the
+     * logging thread itself.
+     */
+    void enable_priority_lane(LogLevel level = LogLevel::ERROR,
+                              bool sync_critical = false) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        priority_lane_ = true;
+        priority_level_ = level;
+        sync_critical_ = sync_critical;
+    }
+
+    /**
+     * Whether timing spans are recorded, i.e. a span sink has been added
+     */
+    inline bool spans_enabled() const { return spans_enabled_; }
+
+    /**
+     * Record a completed timing span
+     * `name` must outlive the logger (string literals do): only the pointer
+     * travels through the queue. Spans ignore the logger level.
+     */
+    void write_span(const char *name, int64_t start_us, int64_t duration_us) {
+        if (!spans_enabled_) {
+            return;
+        }
+        LogRecord record{LogLevel::DEBUG, std::string()};
+        record.span_name = name;
+        record.span_start_us = start_us;
+        record.span_duration_us = duration_us;
+        record.thread_id = get_thread_number();
+        enqueue_or_write(std::move(record));
     }
 
-    // Delete copy constructor and assignment operator
-    Logger(const Logger &) = delete;
-    Logger &operator=(const Logger &) = delete;
-
-    inline void set_level(LogLevel level) { min_level_ = level; }
-
     inline void debug(const std::string &message) {
         write_log(LogLevel::DEBUG, message);
     }
@@ -112,13 +3779,28 @@ class Logger {
      */
     template <typename... Args>
     inline void log(LogLevel level, const std::string &format, Args... args) {
-        if (level < min_level_)
+        if (filtered(level))
             return;
         std::ostringstream ss;
         format_message(ss, format, args...);
         write_log(level, ss.str());
     }
 
+    /**
+     * Log regardless of the logger level
+     * Used by call sites enabled at runtime through CallSiteRegistry.
+     */
+    inline void force_log(LogLevel level, const std::string &message) {
+        submit_log(level, message, false);
+    }
+
+    template <typename... Args>
+    void force_log(LogLevel level, const std::string &format, Args... args) {
+        std::ostringstream ss;
+        format_message(ss, format, args...);
+        submit_log(level, ss.str(), false);
+    }
+
     template <typename... Args>
     void debug(const std::string &format, Args... args) {
         log(LogLevel::DEBUG, format, args...);
@@ -145,113 +3827,980 @@ class Logger {
     }
 
   private:
-    std::ofstream log_file_;
+    std::string filename_;
+    LogFile log_file_;
     std::mutex mutex_;
-    LogLevel min_level_;
+    std::atomic<LogLevel> min_level_;
+    std::atomic<LogLevel> threshold_;
     bool async_mode_;
+    std::vector<std::shared_ptr<Sink>> sinks_;
+    std::vector<std::unique_ptr<SinkWorker>> sink_workers_;
+    std::atomic<size_t> sink_worker_count_{0}; // published by enable_sink_workers
+    OutputHealth file_health_;
+    std::atomic<bool> spans_enabled_{false};
+    std::atomic<unsigned> reopen_generation_;
+
+    // Durable mode members
+    int sync_fd_ = -1;
+    std::chrono::microseconds commit_delay_{0};
+    std::mutex durable_mutex_;
+    std::condition_variable durable_cv_;
+    uint64_t durable_seq_ = 0;
+    bool sync_failed_ = false;
+
+    // Buffered writes members; the spare buffer is guarded by mutex_
+    std::atomic<bool> buffered_{false};
+    std::mutex buffer_mutex_;
+    std::condition_variable buffer_cv_;
+    std::string active_buffer_;
+    std::string spare_buffer_;
+    size_t buffer_bytes_ = 0;
+    std::chrono::milliseconds flush_interval_{0};
+    bool stop_flusher_ = false;
+    std::thread flusher_thread_;
+
+    // Time index members
+    std::ofstream index_file_;
+    uint64_t file_offset_ = 0; // just past our last write
+    uint64_t next_index_offset_ = 0;
+    size_t index_block_bytes_ = 0;
+    std::vector<const std::string *> batch_lines_;
 
     // Async members
-    std::queue<std::string> log_queue_;
+    std::queue<LogRecord> log_queue_;
     std::condition_variable cv_;
     std::thread worker_thread_;
     std::atomic<bool> stop_thread_;
     std::mutex queue_mutex_;
+    uint64_t enqueued_seq_ = 0;
+    uint64_t normal_seq_ = 0; // last sequence number of each lane
+    uint64_t priority_seq_ = 0;
+    std::queue<LogRecord> priority_queue_;
+    bool priority_lane_ = false;
+    LogLevel priority_level_ = LogLevel::ERROR;
+    std::atomic<bool> sync_critical_{false};
+    size_t queue_capacity_ = 0;
+    OverflowPolicy overflow_policy_ = OverflowPolicy::BLOCK;
+    uint64_t dropped_ = 0;
+    int space_waiters_ = 0;
+    std::condition_variable space_cv_;
+    enum : size_t { WORKER_BATCH = 64 }; // records written at a time
+#ifdef MINISPDLOG_POSIX
+    enum : size_t { SPILL_BATCH = 1024 }; // records read back at a time
+    std::unique_ptr<SpillFile> spill_;
+#endif
+
+    // Load shedding, guarded by queue_mutex_ except for the counter
+    struct Repeat {
+        size_t hash = 0;
+        size_t count = 0;
+    };
+    enum : size_t { REPEAT_SLOTS = 64 };
+    size_t shed_high_ = 0;
+    size_t shed_low_ = 0;
+    size_t shed_sample_ = 10;
+    int shed_step_ = 0;
+    LogLevel shed_level_ = LogLevel::DEBUG;
+    uint64_t shed_at_start_ = 0;
+    Repeat repeats_[REPEAT_SLOTS];
+    std::atomic<uint64_t> shed_{0};
+    std::atomic<uint64_t> written_seq_{0};
+    std::atomic<uint64_t> priority_written_seq_{0};
+    std::atomic<uint64_t> records_written_{0};
+    std::atomic<size_t> sink_count_{0};
+    // Copy of sinks_ for stats(), which must not wait for a stalled write
+    std::shared_ptr<const std::vector<std::shared_ptr<Sink>>> sink_snapshot_ =
+        std::make_shared<const std::vector<std::shared_ptr<Sink>>>();
+    std::atomic<int> flush_waiters_{0};
+    std::mutex flush_mutex_;
+    std::condition_variable flush_cv_;
 
     inline std::string level_to_string(LogLevel level) {
-        switch (level) {
-        case LogLevel::DEBUG:
-            return "DEBUG";
-        case LogLevel::INFO:
-            return "INFO";
-        case LogLevel::WARN:
-            return "WARN";
-        case LogLevel::ERROR:
-            return "ERROR";
-        case LogLevel::CRITICAL:
-            return "CRITICAL";
-        default:
-            return "UNKNOWN";
+        return level_name(level);
+    }
+
+    /**
+     * Get the current timestamp
+     * This method returns the given time in the format "YYYY-MM-DD
+     * HH:MM:SS.mmmmmm".
+     */
+    inline std::string get_timestamp(std::chrono::system_clock::time_point now) {
+        auto time = std::chrono::system_clock::to_time_t(now);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      now.time_since_epoch()) %
+                  1000000;
+        std::stringstream ss;
+        ss << std::put_time(std::localtime(&time), Config::TIMESTAMP_FORMAT) << '.'
+           << std::setfill('0') << std::setw(Config::TIMESTAMP_PRECISION) << us.count();
+        return ss.str();
+    }
+
+    /**
+     * Worker function for asynchronous logging
+     * This function runs in a separate thread and processes log messages from
+     * the queue. It writes them to the log file.
+     */
+    void worker_function() {
+        // Durable records written but not synced yet, and when to sync them
+        bool commit_pending = false;
+        std::chrono::steady_clock::time_point commit_deadline;
+        std::vector<LogRecord> batch;
+        std::vector<bool> early; // priority records written ahead of others
+
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        while (!stop_thread_ || !is_idle()) {
+            // Spilled records may still be on their way to the file
+            auto ready = [this] {
+                return has_work() || (stop_thread_ && is_idle());
+            };
+            if (commit_pending) {
+                cv_.wait_until(lock, commit_deadline, ready);
+            } else {
+                cv_.wait(lock, ready);
+            }
+
+            while (!priority_queue_.empty() || unspill(lock)) {
+                // Take what is queued, up to a batch, to write it at once
+                uint64_t priority_seq = 0, normal_seq = 0;
+                bool durable = false;
+                batch.clear();
+                early.clear();
+                do {
+                    bool priority = !priority_queue_.empty();
+                    auto &lane = priority ? priority_queue_ : log_queue_;
+                    batch.push_back(std::move(lane.front()));
+                    lane.pop();
+                    const LogRecord &record = batch.back();
+                    early.push_back(priority && oldest_normal() < record.seq);
+                    (priority ? priority_seq : normal_seq) = record.seq;
+                    durable = durable || record.durable;
+                } while (batch.size() < WORKER_BATCH &&
+                         (!priority_queue_.empty() || !log_queue_.empty()));
+                if (space_waiters_) {
+                    space_cv_.notify_all();
+                }
+                if (shed_step_) {
+                    update_shedding(&batch);
+                    early.resize(batch.size());
+                }
+                lock.unlock();
+
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    if (!batch[i].span_name) {
+                        batch[i].entry = format_log_entry(batch[i], early[i]);
+                    }
+                }
+
+                check_reopen_signal();
+                std::lock_guard<std::mutex> file_lock(mutex_);
+                write_batch(batch);
+                if (priority_seq) {
+                    priority_written_seq_ = priority_seq;
+                }
+                if (normal_seq) {
+                    written_seq_ = normal_seq;
+                }
+                if (flush_waiters_ > 0) {
+                    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+                    flush_cv_.notify_all();
+                }
+                if (durable && !commit_pending) {
+                    commit_pending = true;
+                    commit_deadline =
+                        std::chrono::steady_clock::now() + commit_delay_;
+                }
+                if (is_queue_empty()) {
+                    flush_sinks();
+                }
+                if (commit_pending &&
+                    std::chrono::steady_clock::now() >= commit_deadline) {
+                    commit_pending = false;
+                    group_commit();
+                }
+                lock.lock();
+            }
+
+            if (commit_pending &&
+                (stop_thread_ ||
+                 std::chrono::steady_clock::now() >= commit_deadline)) {
+                commit_pending = false;
+                lock.unlock();
+                {
+                    std::lock_guard<std::mutex> file_lock(mutex_);
+                    group_commit();
+                }
+                lock.lock();
+            }
+        }
+    }
+
+    /**
+     * Sync everything written so far and complete the waiting tickets
+     * Must be called with mutex_ held.
+     */
+    void group_commit() {
+        bool ok = sync_file();
+        std::lock_guard<std::mutex> lock(durable_mutex_);
+        durable_seq_ = written_seq_;
+        sync_failed_ = sync_failed_ || !ok;
+        durable_cv_.notify_all();
+    }
+
+    /**
+     * Push the log file to stable storage
+     * fdatasync works on any descriptor of the file, so a separate one is
+     * kept next to the log file's own. Must be called with mutex_ held.
+     */
+    bool sync_file() {
+        if (!log_file_.good()) {
+            return false;
+        }
+#if defined(MINISPDLOG_POSIX) && defined(__APPLE__)
+        return sync_fd_ >= 0 && ::fsync(sync_fd_) == 0;
+#elif defined(MINISPDLOG_POSIX)
+        return sync_fd_ >= 0 && ::fdatasync(sync_fd_) == 0;
+#else
+        return false;
+#endif
+    }
+
+#ifdef MINISPDLOG_POSIX
+    static int open_sync_fd(const std::string &filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open log file for syncing: " +
+                                     filename);
+        }
+        return fd;
+    }
+#endif
+
+    /**
+     * Get the current thread ID
+     * This helper function extracts thread ID calculation logic
+     */
+    inline size_t get_thread_number() {
+        return std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+               Config::THREAD_ID_MODULO;
+    }
+
+    /**
+     * Format a complete log entry with timestamp, level, thread ID, and message
+     * This centralizes the log entry formatting logic to reduce duplication
+     */
+    std::string format_log_entry(const LogRecord &record, bool early = false) {
+        std::string entry = get_timestamp(record.time) + " [" +
+                            level_to_string(record.level) + "] [Thread:" +
+                            std::to_string(record.thread_id) + "]";
+        if (early) {
+            entry += record.context
+                         ? " [order=early " + record.context->rendered.substr(2)
+                         : std::string(" [order=early]");
+        } else if (record.context) {
+            entry += record.context->rendered;
+        }
+        entry += ' ';
+        entry += record.message;
+        return entry;
+    }
+
+    /**
+     * Write the log message to the file
+     * This method is used to write the log message to the file. It formats the
+     * message with a timestamp and thread ID.
+     */
+    uint64_t write_log(LogLevel level, const std::string &message,
+                       bool durable = false) {
+        if (durable ? level < min_level_.load(std::memory_order_relaxed)
+                    : filtered(level))
+            return 0;
+        return submit_log(level, message, durable);
+    }
+
+    /**
+     * Level check of the logging methods
+     * While load shedding is active the threshold is above the logger level
+     * and the records in between are counted as shed.
+     */
+    inline bool filtered(LogLevel level) {
+        if (level < threshold_.load(std::memory_order_relaxed)) {
+            if (level >= min_level_.load(std::memory_order_relaxed)) {
+                shed_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Build a record from the message and pass it on, whatever the level
+     */
+    uint64_t submit_log(LogLevel level, const std::string &message,
+                        bool durable) {
+        LogRecord record{level, std::string()};
+        record.durable = durable;
+        record.message = message;
+        record.time = std::chrono::system_clock::now();
+        record.thread_id = get_thread_number();
+        record.context = LogContext::current();
+        if (!async_mode_) {
+            record.entry = format_log_entry(record);
+        }
+        return enqueue_or_write(std::move(record));
+    }
+
+    /**
+     * Hand a record to the worker, or write it right away in sync mode
+     * Returns the sequence number of the record, 0 for non-durable records
+     * in sync mode.
+     */
+    uint64_t enqueue_or_write(LogRecord &&record) {
+        if (async_mode_ && record.level == LogLevel::CRITICAL &&
+            sync_critical_.load(std::memory_order_relaxed) &&
+            !record.durable && !record.span_name) {
+            write_critical(record);
+            return 0;
+        }
+        if (async_mode_) {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (shed_step_ && !record.durable && !record.span_name &&
+                record.level < LogLevel::ERROR && !sample(record.message)) {
+                shed_.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+            if (priority_lane_ && record.level >= priority_level_ &&
+                !record.durable && !record.span_name) {
+                uint64_t seq = record.seq = priority_seq_ = ++enqueued_seq_;
+                priority_queue_.push(std::move(record));
+                cv_.notify_one();
+                return seq;
+            }
+            bool full = queue_capacity_ && log_queue_.size() >= queue_capacity_;
+            if (full || spilled()) {
+                if (full && overflow_policy_ == OverflowPolicy::DROP &&
+                    !record.durable) {
+                    dropped_++;
+                    return 0;
+                }
+                // Once records wait in the spill file, the next ones queue
+                // up behind them there
+                if (overflow_policy_ == OverflowPolicy::SPILL || spilled()) {
+                    if (uint64_t seq = spill(record, lock)) {
+                        return seq;
+                    }
+                    if (!record.durable) {
+                        dropped_++;
+                        return 0;
+                    }
+                }
+                space_waiters_++;
+                space_cv_.wait(lock, [this] {
+                    return !spilled() && (!queue_capacity_ ||
+                                          log_queue_.size() < queue_capacity_);
+                });
+                space_waiters_--;
+            }
+            uint64_t seq = record.seq = normal_seq_ = ++enqueued_seq_;
+            log_queue_.push(std::move(record));
+            if (shed_high_) {
+                update_shedding();
+            }
+            cv_.notify_one();
+            return seq;
+        }
+
+        check_reopen_signal();
+        if (buffered_.load(std::memory_order_relaxed) && !record.durable) {
+            write_buffered(record);
+            return 0;
+        }
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        drain_buffer(); // keeps durable records behind the buffered ones
+        write_record(record);
+        flush_sinks();
+        if (record.durable) {
+            record.seq = ++written_seq_;
+            group_commit();
+        }
+        return record.seq;
+    }
+
+    /**
+     * Sync mode write with buffered writes enabled
+     * The entry is appended to the active buffer under buffer_mutex_ only;
+     * the sinks, if any, are still written right away. A producer that
+     * finds the buffer at twice its size, because the flusher is behind,
+     * writes it out itself.
+     */
+    void write_buffered(const LogRecord &record) {
+        bool full = false;
+        if (!record.span_name) {
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            active_buffer_ += record.entry;
+            active_buffer_ += '\n';
+            if (active_buffer_.size() >= buffer_bytes_) {
+                full = active_buffer_.size() >= 2 * buffer_bytes_;
+                buffer_cv_.notify_one();
+            }
+        }
+        if (full || sink_count_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> file_lock(mutex_);
+            if (full) {
+                drain_buffer();
+            }
+            write_sinks(record);
+            flush_sinks();
+        }
+        if (!record.span_name) {
+            records_written_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Write out the active buffer of buffered writes
+     * Swaps it with the spare one, so producers only wait for the swap.
+     * Must be called with mutex_ held: everything that writes the buffer
+     * out takes mutex_ first, which keeps the swaps in order.
+     */
+    void drain_buffer() {
+        if (!buffered_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            active_buffer_.swap(spare_buffer_);
+        }
+        if (spare_buffer_.empty()) {
+            return;
+        }
+        if (write_file(spare_buffer_, false)) {
+            index_buffer(spare_buffer_, file_offset_ - spare_buffer_.size());
+        }
+        spare_buffer_.clear();
+    }
+
+    /**
+     * Add the time index entries for a block of lines written at `offset`
+     * Finds the first line starting at or after each index point, as
+     * write_record() does one record at a time. Must be called with mutex_
+     * held.
+     */
+    void index_buffer(const std::string &block, uint64_t offset) {
+        if (!index_block_bytes_) {
+            return;
+        }
+        while (offset + block.size() > next_index_offset_) {
+            size_t start = 0;
+            if (next_index_offset_ > offset) {
+                size_t newline =
+                    block.find('\n', next_index_offset_ - offset - 1);
+                if (newline == std::string::npos ||
+                    newline + 1 >= block.size()) {
+                    return;
+                }
+                start = newline + 1;
+            }
+            index_file_ << TimeIndex::format_entry(block.substr(start, 32),
+                                                   offset + start)
+                        << std::flush;
+            next_index_offset_ = offset + start + index_block_bytes_;
+        }
+    }
+
+    /**
+     * Background flusher of buffered writes
+     * Writes the buffer out every interval, or as soon as it is full.
+     */
+    void flusher_function() {
+        std::unique_lock<std::mutex> lock(buffer_mutex_);
+        while (!stop_flusher_) {
+            buffer_cv_.wait_for(lock, flush_interval_, [this] {
+                return stop_flusher_ || active_buffer_.size() >= buffer_bytes_;
+            });
+            lock.unlock();
+            check_reopen_signal();
+            {
+                std::lock_guard<std::mutex> file_lock(mutex_);
+                drain_buffer();
+            }
+            lock.lock();
+        }
+    }
+
+    /**
+     * Write a CRITICAL record from the logging thread, ahead of the queues
+     * The file and the sinks are flushed before returning.
+     */
+    void write_critical(LogRecord &record) {
+        bool early;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            early = !is_idle();
+        }
+        record.entry = format_log_entry(record, early);
+        check_reopen_signal();
+        std::lock_guard<std::mutex> file_lock(mutex_);
+        write_record(record);
+        flush_sinks();
+    }
+
+    static std::atomic<unsigned> &reopen_signal_generation() {
+        static std::atomic<unsigned> generation(0);
+        return generation;
+    }
+
+    static void handle_reopen_signal(int) {
+        reopen_signal_generation().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Reopen the log file if a signal asked for it since the last check
+     * Costs one relaxed load when nothing happened. A failed reopen keeps
+     * writing to the current file.
+     */
+    inline void check_reopen_signal() {
+        unsigned seen = reopen_generation_.load(std::memory_order_relaxed);
+        unsigned current =
+            reopen_signal_generation().load(std::memory_order_relaxed);
+        if (seen != current &&
+            reopen_generation_.compare_exchange_strong(seen, current)) {
+            try {
+                reopen();
+            } catch (const std::runtime_error &) {
+            }
+        }
+    }
+
+    static uint64_t current_file_size(const std::string &filename) {
+        std::ifstream existing(filename, std::ios::binary | std::ios::ate);
+        return existing.is_open() ? static_cast<uint64_t>(existing.tellg()) : 0;
+    }
+
+    /**
+     * Write a record to the log file and the sinks
+     * Must be called with mutex_ held.
+     */
+    void write_record(const LogRecord &record) {
+        if (record.span_name) {
+            write_sinks(record);
+            return;
+        }
+        if (log_file_.is_open() && write_file(record.entry)) {
+            index_record(record, file_offset_ - record.entry.size() - 1);
+        }
+        write_sinks(record);
+        records_written_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Write a batch of records, the file part in a single write
+     * Must be called with mutex_ held.
+     */
+    void write_batch(const std::vector<LogRecord> &batch) {
+        batch_lines_.clear();
+        size_t bytes = 0;
+        for (const auto &record : batch) {
+            if (!record.span_name) {
+                batch_lines_.push_back(&record.entry);
+                bytes += record.entry.size() + 1;
+            }
+        }
+        if (!batch_lines_.empty() && log_file_.is_open() &&
+            write_file(batch_lines_)) {
+            uint64_t offset = file_offset_ - bytes;
+            for (const auto &record : batch) {
+                if (!record.span_name) {
+                    index_record(record, offset);
+                    offset += record.entry.size() + 1;
+                }
+            }
+        }
+        for (const auto &record : batch) {
+            write_sinks(record);
+        }
+        records_written_.fetch_add(batch_lines_.size(),
+                                   std::memory_order_relaxed);
+    }
+
+    /**
+     * Add a time index entry for a record written at `offset` if one is due
+     * Must be called with mutex_ held.
+     */
+    void index_record(const LogRecord &record, uint64_t offset) {
+        if (index_block_bytes_ && offset >= next_index_offset_) {
+            index_file_ << TimeIndex::format_entry(record.entry, offset)
+                        << std::flush;
+            next_index_offset_ = offset + index_block_bytes_;
+        }
+    }
+
+    /**
+     * Write an entry to the log file, watching for errors
+     * A failed write degrades the file like a sink (see OutputHealth): the
+     * stream state is cleared and the entries go to stderr until the retry.
+     * `text` is a single entry, or whole lines when `newline` is false.
+     * Returns whether the file got the text. Must be called with mutex_
+     * held.
+     */
+    bool write_file(const std::string &text, bool newline = true) {
+        if (file_health_.available()) {
+            if (log_file_.write(text.data(), text.size(), newline)) {
+                file_written(text.size() + (newline ? 1 : 0));
+                return true;
+            }
+            file_failed();
+        }
+        file_health_.dropped(
+            newline ? 1 : std::count(text.begin(), text.end(), '\n'));
+        std::cerr << text << (newline ? "\n" : "");
+        return false;
+    }
+
+    /**
+     * Write entries to the log file in one write, as write_file() does one
+     */
+    bool write_file(const std::vector<const std::string *> &lines) {
+        if (file_health_.available()) {
+            if (log_file_.write_lines(lines.data(), lines.size())) {
+                size_t bytes = 0;
+                for (const auto *line : lines) {
+                    bytes += line->size() + 1;
+                }
+                file_written(bytes);
+                return true;
+            }
+            file_failed();
+        }
+        file_health_.dropped(lines.size());
+        for (const auto *line : lines) {
+            std::cerr << *line << "\n";
+        }
+        return false;
+    }
+
+    /**
+     * Account for `bytes` written to the log file
+     * Other processes may append to the file as well: when the time index
+     * needs to know where the bytes went, the offset comes from the file.
+     */
+    void file_written(size_t bytes) {
+        file_offset_ = index_block_bytes_ ? log_file_.offset()
+                                          : file_offset_ + bytes;
+        if (file_health_.succeeded()) {
+            std::cerr << "minispdlog: log file " << filename_ << " recovered, "
+                      << file_health_.dropped_count()
+                      << " records dropped so far" << std::endl;
+        }
+    }
+
+    void file_failed() {
+        log_file_.clear();
+        std::cerr << "minispdlog: writing " << filename_
+                  << " failed, retrying in " << file_health_.failed().count()
+                  << " ms" << std::endl;
+    }
+
+    /**
+     * Write a record to the sinks that want it, or queue it for the sink
+     * workers. Must be called with mutex_ held.
+     */
+    void write_sinks(const LogRecord &record) {
+        if (!sink_workers_.empty()) {
+            auto shared = std::make_shared<const LogRecord>(record);
+            for (auto &worker : sink_workers_) {
+                worker->push(shared);
+            }
+            return;
+        }
+        for (auto &sink : sinks_) {
+            if (record.span_name ? sink->accepts_spans()
+                                 : sink->should_write(record.level)) {
+                sink->checked_write(record);
+            }
+        }
+    }
+
+    /**
+     * Flush the sinks at the end of a batch
+     * Sink workers flush their own sinks. Must be called with mutex_ held.
+     */
+    void flush_sinks() {
+        if (!sink_workers_.empty()) {
+            return;
+        }
+        for (auto &sink : sinks_) {
+            sink->checked_flush();
+        }
+    }
+
+    /**
+     * Publish the sink list to stats()
+     * Must be called with mutex_ held.
+     */
+    void sinks_changed() {
+        sink_count_.store(sinks_.size(), std::memory_order_relaxed);
+        std::atomic_store(
+            &sink_snapshot_,
+            std::make_shared<const std::vector<std::shared_ptr<Sink>>>(sinks_));
+    }
+
+    /**
+     * Remove and add sinks for replace_sinks()
+     * Must be called with mutex_ held.
+     */
+    void swap_sinks(const std::vector<std::shared_ptr<Sink>> &removed,
+                    const std::vector<std::shared_ptr<Sink>> &added) {
+        for (const auto &sink : removed) {
+            auto it = std::find(sinks_.begin(), sinks_.end(), sink);
+            if (it != sinks_.end()) {
+                if (sink_workers_.empty()) {
+                    (*it)->checked_flush();
+                }
+                for (auto &worker : sink_workers_) {
+                    worker->remove(sink);
+                }
+                sinks_.erase(it);
+            }
+        }
+        for (const auto &sink : added) {
+            if (!sink_workers_.empty()) {
+                assign_sink(sink);
+            }
+        }
+        sinks_.insert(sinks_.end(), added.begin(), added.end());
+        bool spans = false;
+        for (const auto &sink : sinks_) {
+            spans = spans || sink->accepts_spans();
+        }
+        spans_enabled_ = spans;
+        sinks_changed();
+    }
+
+    /**
+     * The sink workers, read without mutex_ since the set is fixed once
+     * enabled
+     */
+    std::vector<SinkWorker *> workers() const {
+        std::vector<SinkWorker *> result;
+        size_t count = sink_worker_count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            result.push_back(sink_workers_[i].get());
+        }
+        return result;
+    }
+
+    /**
+     * Give a sink to the sink worker with the fewest sinks
+     * Must be called with mutex_ held.
+     */
+    void assign_sink(const std::shared_ptr<Sink> &sink) {
+        SinkWorker *least = sink_workers_.front().get();
+        for (auto &worker : sink_workers_) {
+            if (worker->size() < least->size()) {
+                least = worker.get();
+            }
+        }
+        least->add(sink);
+    }
+
+    /**
+     * Move between load shedding steps as the queue fills and drains
+     * The change is logged at the end of the queue, or, from the worker,
+     * at the end of the `batch` it is writing: the notice then shares the
+     * sequence number of the record before it, so a flush() waiting for
+     * that record sees the notice written too. Must be called with
+     * queue_mutex_ held.
+     */
+    void update_shedding(std::vector<LogRecord> *batch = nullptr) {
+        size_t depth = log_queue_.size() + spilled();
+        int step = shed_step_;
+        if (shed_high_ && depth >= 2 * shed_high_) {
+            step = 2;
+        } else if (shed_high_ && depth >= shed_high_) {
+            step = std::max(step, 1);
+        } else if (depth <= shed_low_) {
+            step = 0;
+        }
+        if (step == shed_step_) {
+            return;
+        }
+        LogRecord notice = set_shed_step(step, depth);
+        if (batch) {
+            notice.seq = batch->back().seq;
+            batch->push_back(std::move(notice));
+        } else {
+            notice.seq = normal_seq_ = ++enqueued_seq_;
+            log_queue_.push(std::move(notice));
         }
     }
 
     /**
-     * Get the current timestamp
-     * This method returns the current timestamp in the format "YYYY-MM-DD
-     * HH:MM:SS.mmmmmm".
+     * Apply a load shedding step; returns the record logging the change
+     * Must be called with queue_mutex_ held.
      */
-    inline std::string get_timestamp() {
-        auto now = std::chrono::system_clock::now();
-        auto time = std::chrono::system_clock::to_time_t(now);
-        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
-                      now.time_since_epoch()) %
-                  1000000;
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&time), Config::TIMESTAMP_FORMAT) << '.'
-           << std::setfill('0') << std::setw(Config::TIMESTAMP_PRECISION) << us.count();
-        return ss.str();
+    LogRecord set_shed_step(int step, size_t depth) {
+        if (!shed_step_) {
+            shed_at_start_ = shed_.load(std::memory_order_relaxed);
+        }
+        shed_step_ = step;
+        shed_level_ = step == 0   ? LogLevel::DEBUG
+                      : step == 1 ? LogLevel::INFO
+                                  : LogLevel::WARN;
+        threshold_.store(
+            std::max(min_level_.load(std::memory_order_relaxed), shed_level_),
+            std::memory_order_relaxed);
+
+        std::ostringstream ss;
+        if (step) {
+            ss << "Load shedding: " << depth << " records queued, dropping "
+               << "below " << level_name(shed_level_)
+               << ", sampling repeated messages 1/" << shed_sample_;
+        } else {
+            std::fill(std::begin(repeats_), std::end(repeats_), Repeat());
+            ss << "Load shedding ended: "
+               << shed_.load(std::memory_order_relaxed) - shed_at_start_
+               << " records shed";
+        }
+        LogRecord record{LogLevel::WARN, std::string()};
+        record.message = ss.str();
+        record.time = std::chrono::system_clock::now();
+        record.thread_id = get_thread_number();
+        return record;
     }
 
     /**
-     * Worker function for asynchronous logging
-     * This function runs in a separate thread and processes log messages from
-     * the queue. It writes them to the log file.
+     * Whether to keep a message while shedding load
+     * Messages are told apart by a hash in a small table; the first of a
+     * series is kept, then one out of shed_sample_. Must be called with
+     * queue_mutex_ held.
      */
-    void worker_function() {
-        while (!stop_thread_ || !log_queue_.empty()) {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            cv_.wait(lock,
-                     [this] { return !log_queue_.empty() || stop_thread_; });
-
-            while (!log_queue_.empty()) {
-                std::string log_message = log_queue_.front();
-                log_queue_.pop();
-                lock.unlock();
-
-                std::lock_guard<std::mutex> file_lock(mutex_);
-                log_file_ << log_message << std::endl << std::flush;
-                lock.lock();
-            }
+    bool sample(const std::string &message) {
+        size_t hash = std::hash<std::string>()(message);
+        Repeat &repeat = repeats_[hash % REPEAT_SLOTS];
+        if (repeat.hash != hash || !repeat.count) {
+            repeat.hash = hash;
+            repeat.count = 1;
+            return true;
         }
+        return repeat.count++ % shed_sample_ == 0;
+    }
+
+    inline bool is_queue_empty() {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        return is_idle();
     }
 
     /**
-     * Get the current thread ID
-     * This helper function extracts thread ID calculation logic
+     * Whether no record waits for the worker
+     * Must be called with queue_mutex_ held.
      */
-    inline std::string get_thread_id() {
-        return std::to_string(
-            std::hash<std::thread::id>{}(std::this_thread::get_id()) %
-            Config::THREAD_ID_MODULO);
+    inline bool is_idle() const {
+        return log_queue_.empty() && priority_queue_.empty() && !spilled();
     }
 
     /**
-     * Format a complete log entry with timestamp, level, thread ID, and message
-     * This centralizes the log entry formatting logic to reduce duplication
+     * Number of records waiting in the spill file
+     * Must be called with queue_mutex_ held, as must the four below.
      */
-    std::string format_log_entry(LogLevel level, const std::string &message) {
-        return get_timestamp() + " [" + level_to_string(level) + "] [Thread:" +
-               get_thread_id() + "] " + message;
+    inline size_t spilled() const {
+#ifdef MINISPDLOG_POSIX
+        return spill_ ? spill_->pending() : 0;
+#else
+        return 0;
+#endif
     }
 
     /**
-     * Write the log message to the file
-     * This method is used to write the log message to the file. It formats the
-     * message with a timestamp and thread ID.
+     * Sequence number of the oldest record of the normal lane, in the queue
+     * or in the spill file, or the largest value if there is none
      */
-    void write_log(LogLevel level, const std::string &message) {
-        if (level < min_level_)
-            return;
+    uint64_t oldest_normal() const {
+        if (!log_queue_.empty()) {
+            return log_queue_.front().seq;
+        }
+#ifdef MINISPDLOG_POSIX
+        if (spill_) {
+            return spill_->oldest();
+        }
+#endif
+        return UINT64_MAX;
+    }
 
-        std::string log_message = format_log_entry(level, message);
+    /**
+     * Whether the worker has a record to write
+     */
+    bool has_work() const {
+        if (!log_queue_.empty() || !priority_queue_.empty()) {
+            return true;
+        }
+#ifdef MINISPDLOG_POSIX
+        return spill_ && spill_->readable();
+#else
+        return false;
+#endif
+    }
 
-        if (async_mode_) {
-            std::lock_guard<std::mutex> lock(queue_mutex_);
-            log_queue_.push(log_message);
+    /**
+     * Append a record to the spill file
+     * Room is reserved under `lock`, which is released for the write itself
+     * so that other producers and the worker do not wait for the disk.
+     * Returns the sequence number of the record, or 0 (with the lock still
+     * held) if there is no room for it.
+     */
+    uint64_t spill(const LogRecord &record,
+                   std::unique_lock<std::mutex> &lock) {
+#ifdef MINISPDLOG_POSIX
+        size_t offset;
+        if (spill_ && spill_->reserve(record, enqueued_seq_ + 1, offset)) {
+            uint64_t seq = normal_seq_ = ++enqueued_seq_;
+            SpillFile *spill = spill_.get(); // only replaced while idle
+            lock.unlock();
+            spill->write(offset, record, seq);
+            lock.lock();
             cv_.notify_one();
-        } else {
-            std::lock_guard<std::mutex> file_lock(mutex_);
-            log_file_ << log_message << std::endl << std::flush;
+            return seq;
+        }
+#else
+        (void)record;
+        (void)lock;
+#endif
+        return 0;
+    }
+
+    /**
+     * Move spilled records back to the empty queue, up to its capacity
+     * The file is read with `lock` released. Returns whether the queue has
+     * records again. Records that cannot be read are counted as dropped.
+     */
+    bool unspill(std::unique_lock<std::mutex> &lock) {
+#ifdef MINISPDLOG_POSIX
+        if (!log_queue_.empty() || !spill_ || !spill_->readable()) {
+            return !log_queue_.empty();
+        }
+        size_t batch = queue_capacity_ ? queue_capacity_ : SPILL_BATCH;
+        std::vector<LogRecord> records;
+        size_t lost;
+        uint64_t lost_seq = 0;
+        lock.unlock();
+        size_t count = spill_->read(records, batch, lost, lost_seq);
+        lock.lock();
+        for (auto &record : records) {
+            log_queue_.push(std::move(record));
+        }
+        spill_->release(count);
+        if (lost) {
+            dropped_ += lost;
+            if (log_queue_.empty() && lost_seq > written_seq_) {
+                // Nothing left to write before them: let flush() through
+                written_seq_ = lost_seq;
+                std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+                flush_cv_.notify_all();
+            }
         }
+#else
+        (void)lock;
+#endif
+        return !log_queue_.empty();
     }
 
     /**
@@ -259,10 +4808,14 @@ class Logger {
      * This helper function centralizes file initialization logic
      */
     void initialize_log_file(const std::string &filename) {
-        log_file_.open(filename, std::ios::app);
-        if (!log_file_.is_open()) {
+        filename_ = filename;
+        if (filename.empty()) {
+            return; // sinks only
+        }
+        if (!log_file_.open(filename)) {
             throw std::runtime_error("Unable to open log file: " + filename);
         }
+        file_offset_ = current_file_size(filename);
     }
 
     /**
@@ -295,6 +4848,369 @@ class Logger {
     }
 };
 
+inline bool DurableTicket::wait() const {
+    return seq_ == 0 || logger_->wait_durable(seq_);
+}
+
+inline bool DurableTicket::wait_for(std::chrono::milliseconds timeout) const {
+    return seq_ == 0 || logger_->wait_durable(seq_, timeout);
+}
+
+/**
+ * RAII timing span, see SLOG_SCOPE
+ * Costs one relaxed check when no span sink is installed, and two steady
+ * clock reads plus one record otherwise.
+ */
+class ScopedSpan {
+  public:
+    ScopedSpan(Logger &logger, const char *name)
+        : logger_(logger.spans_enabled() ? &logger : nullptr), name_(name),
+          start_us_(logger_ ? now_us() : 0) {}
+
+    ~ScopedSpan() {
+        if (logger_) {
+            logger_->write_span(name_, start_us_, now_us() - start_us_);
+        }
+    }
+
+    ScopedSpan(const ScopedSpan &) = delete;
+    ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+  private:
+    Logger *logger_;
+    const char *name_;
+    int64_t start_us_;
+
+    static inline int64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+};
+
+/**
+ * Logger configuration read from a file and the environment
+ * The file holds "key = value" lines, '#' starting a comment:
+ *
+ *     file = app.log
+ *     level = INFO
+ *     async = true
+ *     queue_size = 10000
+ *     overflow = drop               # or block, or spill
+ *     spill_file = /var/tmp/app.spill
+ *     spill_size = 67108864
+ *     sink_threads = 2              # see Logger::enable_sink_workers
+ *     preallocate = 67108864        # see LogFile
+ *     drop_cache = 8388608
+ *     shed_high = 5000              # see Logger::enable_load_shedding
+ *     shed_low = 1000
+ *     shed_sample = 10
+ *     level.net* = DEBUG            # call sites in files matching net*
+ *     sink = file:copy.log          # repeatable
+ *     sink = console:stdout         # or console:stderr
+ *     sink = syslog:/dev/log
+ *     sink = journal:/run/systemd/journal/socket
+ *     sink = trace:trace.json
+ *     sink = compressed:app.slz
+ *     sink = flight:app.ring:1048576
+ *
+ * The plain keys can also be given as SLOG_<KEY> environment variables
+ * (SLOG_LEVEL, SLOG_QUEUE_SIZE, ...), which take precedence over the file.
+ */
+struct LoggerSettings {
+    std::string file;
+    LogLevel level = LogLevel::DEBUG;
+    bool async = false;
+    size_t queue_size = 0;
+    OverflowPolicy overflow = OverflowPolicy::BLOCK;
+    std::string spill_file;
+    size_t spill_size = 64 * 1024 * 1024;
+    size_t sink_threads = 0;
+    size_t preallocate = 0;
+    size_t drop_cache = 0;
+    size_t shed_high = 0;
+    size_t shed_low = 0;
+    size_t shed_sample = 10;
+    std::vector<std::pair<std::string, LogLevel>> site_levels;
+    std::vector<std::string> sinks;
+
+    /**
+     * Apply one setting, throwing std::runtime_error for bad ones
+     */
+    void set(const std::string &key, const std::string &value) {
+        if (key == "file") {
+            file = value;
+        } else if (key == "level") {
+            level = parse_level(value);
+        } else if (key == "async") {
+            async = parse_bool(key, value);
+        } else if (key == "queue_size") {
+            queue_size = parse_size(key, value);
+        } else if (key == "overflow") {
+            if (value == "block") {
+                overflow = OverflowPolicy::BLOCK;
+            } else if (value == "drop") {
+                overflow = OverflowPolicy::DROP;
+            } else if (value == "spill") {
+                overflow = OverflowPolicy::SPILL;
+            } else {
+                throw std::runtime_error("Invalid overflow policy: " + value);
+            }
+        } else if (key == "spill_file") {
+            spill_file = value;
+        } else if (key == "spill_size") {
+            spill_size = parse_size(key, value);
+        } else if (key == "sink_threads") {
+            sink_threads = parse_size(key, value);
+        } else if (key == "preallocate") {
+            preallocate = parse_size(key, value);
+        } else if (key == "drop_cache") {
+            drop_cache = parse_size(key, value);
+        } else if (key == "shed_high") {
+            shed_high = parse_size(key, value);
+        } else if (key == "shed_low") {
+            shed_low = parse_size(key, value);
+        } else if (key == "shed_sample") {
+            shed_sample = parse_size(key, value);
+        } else if (key.compare(0, 6, "level.") == 0 && key.size() > 6) {
+            site_levels.emplace_back(key.substr(6), parse_level(value));
+        } else if (key == "sink") {
+            sinks.push_back(value);
+        } else {
+            throw std::runtime_error("Unknown setting: " + key);
+        }
+    }
+
+    void load_file(const std::string &path) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            throw std::runtime_error("Cannot open config file: " + path);
+        }
+        std::string line;
+        for (int number = 1; std::getline(in, line); ++number) {
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) {
+                continue;
+            }
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) {
+                throw std::runtime_error(path + ":" + std::to_string(number) +
+                                         ": expected key = value");
+            }
+            set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+        }
+    }
+
+    void load_env() {
+        static const char *const KEYS[] = {
+            "file",        "level",      "async",      "queue_size",
+            "overflow",    "spill_file", "spill_size", "sink_threads",
+            "preallocate", "drop_cache", "shed_high",  "shed_low",
+            "shed_sample"};
+        for (const char *key : KEYS) {
+            std::string name = "SLOG_" + std::string(key);
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return std::toupper(c); });
+            if (const char *value = std::getenv(name.c_str())) {
+                set(key, value);
+            }
+        }
+    }
+
+    /**
+     * Build the sinks described by the "sink" entries
+     */
+    std::vector<std::shared_ptr<Sink>> make_sinks() const {
+        std::vector<std::shared_ptr<Sink>> result;
+        for (const auto &spec : sinks) {
+            size_t colon = spec.find(':');
+            std::string type = spec.substr(0, colon);
+            std::string path =
+                colon == std::string::npos ? "" : spec.substr(colon + 1);
+            if (path.empty()) {
+                throw std::runtime_error("Sink without a path: " + spec);
+            }
+            if (type == "file") {
+                result.push_back(std::make_shared<FileSink>(path));
+            } else if (type == "console" &&
+                       (path == "stdout" || path == "stderr")) {
+                result.push_back(std::make_shared<ConsoleSink>(
+                    path == "stdout" ? ConsoleSink::Stream::STDOUT
+                                     : ConsoleSink::Stream::STDERR));
+            } else if (type == "trace") {
+                result.push_back(std::make_shared<TraceEventSink>(path));
+            } else if (type == "compressed") {
+                result.push_back(std::make_shared<CompressedFileSink>(path));
+#ifdef MINISPDLOG_POSIX
+            } else if (type == "syslog") {
+                result.push_back(std::make_shared<SyslogSink>("", path));
+            } else if (type == "journal") {
+                result.push_back(std::make_shared<JournalSink>("", path));
+            } else if (type == "flight") {
+                size_t capacity = 1024 * 1024;
+                size_t sep = path.rfind(':');
+                if (sep != std::string::npos) {
+                    capacity = parse_size("sink", path.substr(sep + 1));
+                    path.resize(sep);
+                }
+                result.push_back(
+                    std::make_shared<FlightRecorderSink>(path, capacity));
+#endif
+            } else {
+                throw std::runtime_error("Unknown sink type: " + type);
+            }
+        }
+        return result;
+    }
+
+  private:
+    static std::string trim(const std::string &s) {
+        size_t begin = s.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+    }
+
+    static LogLevel parse_level(const std::string &value) {
+        LogLevel level;
+        if (!level_from_string(value, level)) {
+            throw std::runtime_error("Invalid log level: " + value);
+        }
+        return level;
+    }
+
+    static bool parse_bool(const std::string &key, const std::string &value) {
+        if (value == "true" || value == "1" || value == "yes" || value == "on") {
+            return true;
+        }
+        if (value == "false" || value == "0" || value == "no" || value == "off") {
+            return false;
+        }
+        throw std::runtime_error("Invalid value for " + key + ": " + value);
+    }
+
+    static size_t parse_size(const std::string &key, const std::string &value) {
+        if (value.empty() ||
+            value.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("Invalid value for " + key + ": " + value);
+        }
+        return static_cast<size_t>(std::stoull(value));
+    }
+};
+
+#ifdef MINISPDLOG_POSIX
+/**
+ * Calls back when a file changes
+ * The directory is watched with inotify on Linux, so editors that replace
+ * the file by renaming are caught; elsewhere, and as a fallback, the file's
+ * size, inode and modification time are compared once a second.
+ */
+class ConfigWatcher {
+  public:
+    ConfigWatcher(const std::string &path, std::function<void()> on_change)
+        : path_(path), on_change_(std::move(on_change)), inotify_fd_(-1) {
+        if (cloexec_pipe(wake_pipe_) != 0) {
+            throw std::runtime_error("Cannot create watcher pipe");
+        }
+#ifdef __linux__
+        size_t slash = path.rfind('/');
+        std::string directory =
+            slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        name_ = slash == std::string::npos ? path : path.substr(slash + 1);
+        inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ >= 0 &&
+            ::inotify_add_watch(inotify_fd_, directory.c_str(),
+                                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            ::close(inotify_fd_);
+            inotify_fd_ = -1;
+        }
+#endif
+        last_ = signature();
+        thread_ = std::thread(&ConfigWatcher::run, this);
+    }
+
+    ~ConfigWatcher() {
+        char stop = 0;
+        if (::write(wake_pipe_[1], &stop, 1) < 0) {
+            // The thread also stops on any poll error
+        }
+        thread_.join();
+        for (int fd : {inotify_fd_, wake_pipe_[0], wake_pipe_[1]}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    ConfigWatcher(const ConfigWatcher &) = delete;
+    ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+  private:
+    std::string path_;
+    std::string name_;
+    std::function<void()> on_change_;
+    int inotify_fd_;
+    int wake_pipe_[2] = {-1, -1};
+    std::string last_;
+    std::thread thread_;
+
+    std::string signature() const {
+        struct stat st;
+        if (::stat(path_.c_str(), &st) != 0) {
+            return "";
+        }
+        return std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) +
+               ":" + std::to_string(st.st_mtime);
+    }
+
+    /**
+     * Drain pending inotify events, true if one names the file
+     */
+    bool file_event() {
+        bool found = false;
+#ifdef __linux__
+        alignas(inotify_event) char buffer[4096];
+        ssize_t n;
+        while ((n = ::read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t pos = 0; pos < n;) {
+                auto *event = reinterpret_cast<inotify_event *>(buffer + pos);
+                if (event->len && name_ == event->name) {
+                    found = true;
+                }
+                pos += sizeof(inotify_event) + event->len;
+            }
+        }
+#endif
+        return found;
+    }
+
+    void run() {
+        pollfd fds[2] = {{wake_pipe_[0], POLLIN, 0}, {inotify_fd_, POLLIN, 0}};
+        nfds_t count = inotify_fd_ >= 0 ? 2 : 1;
+        for (;;) {
+            int ready = ::poll(fds, count, 1000);
+            if (ready < 0 && errno != EINTR) {
+                return;
+            }
+            if (fds[0].revents) {
+                return;
+            }
+            bool changed = count == 2 && (fds[1].revents & POLLIN) &&
+                           file_event();
+            std::string current = signature();
+            if (current != last_) {
+                changed = true;
+                last_ = current;
+            }
+            if (changed && !current.empty()) {
+                on_change_();
+            }
+        }
+    }
+};
+#endif // MINISPDLOG_POSIX
+
 class LoggerManager {
   public:
     /**
@@ -306,11 +5222,84 @@ class LoggerManager {
                            LogLevel min_level = LogLevel::DEBUG,
                            bool async_mode = false) {
         auto &inst = get_instance();
+        stop_watcher(inst);
         std::lock_guard<std::mutex> lock(inst.mutex);
         inst.logger = create_logger(filename, min_level, async_mode);
+        inst.config_path.clear();
+        inst.settings = LoggerSettings();
+        inst.config_sinks.clear();
         inst.initialized = true;
     }
 
+    /**
+     * Initialize the logger from a config file and the environment
+     * See LoggerSettings for the format. `defaults` holds the settings used
+     * when neither the file nor the environment give them. With an empty
+     * path, SLOG_CONFIG names the file, if set. On POSIX systems the file is
+     * then watched and reloaded when it changes.
+     */
+    static void configure(const std::string &config_path = "",
+                          const LoggerSettings &defaults = LoggerSettings()) {
+        auto &inst = get_instance();
+        stop_watcher(inst);
+        std::string path = config_path;
+        if (path.empty() && std::getenv("SLOG_CONFIG")) {
+            path = std::getenv("SLOG_CONFIG");
+        }
+        LoggerSettings settings = load_settings(path, defaults);
+        auto sinks = settings.make_sinks();
+        {
+            std::lock_guard<std::mutex> lock(inst.mutex);
+            inst.logger =
+                create_logger(settings.file, settings.level, settings.async);
+            if (!settings.spill_file.empty()) {
+                inst.logger->enable_spill(settings.spill_file,
+                                          settings.spill_size);
+            }
+            if (settings.async && settings.sink_threads) {
+                inst.logger->enable_sink_workers(settings.sink_threads);
+            }
+            inst.initialized = true;
+            inst.config_path = path;
+            inst.defaults = defaults;
+            inst.settings = LoggerSettings();
+            inst.config_sinks.clear();
+            apply_settings(inst, settings, sinks);
+        }
+#ifdef MINISPDLOG_POSIX
+        if (!path.empty()) {
+            inst.watcher.reset(new ConfigWatcher(path, [] { reload(); }));
+        }
+#endif
+    }
+
+    /**
+     * Read the config file again and apply it
+     * Levels, call site levels, queue size and sinks take effect right
+     * away; the file and async settings only at the next configure(). An
+     * invalid file is reported on stderr and leaves the running setup
+     * alone. Returns whether the new settings were applied.
+     */
+    static bool reload() {
+        auto &inst = get_instance();
+        std::lock_guard<std::mutex> lock(inst.mutex);
+        validate_logger_initialized(inst);
+        try {
+            LoggerSettings settings =
+                load_settings(inst.config_path, inst.defaults);
+            std::vector<std::shared_ptr<Sink>> sinks;
+            if (settings.sinks != inst.settings.sinks) {
+                sinks = settings.make_sinks();
+            }
+            apply_settings(inst, settings, sinks);
+        } catch (const std::exception &e) {
+            std::cerr << "minispdlog: config not reloaded: " << e.what()
+                      << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     /**
      * Get the logger instance
      * This method returns a reference to the logger instance. It throws an
@@ -329,7 +5318,11 @@ class LoggerManager {
      */
     static void shutdown() {
         auto &inst = get_instance();
+        stop_watcher(inst);
         std::lock_guard<std::mutex> lock(inst.mutex);
+        inst.config_path.clear();
+        inst.settings = LoggerSettings();
+        inst.config_sinks.clear();
         inst.logger.reset();
         inst.initialized = false;
     }
@@ -344,14 +5337,69 @@ class LoggerManager {
         std::unique_ptr<Logger> logger;
         std::mutex mutex;
         bool initialized = false;
+        std::string config_path;
+        LoggerSettings defaults;
+        LoggerSettings settings;
+        std::vector<std::shared_ptr<Sink>> config_sinks;
+#ifdef MINISPDLOG_POSIX
+        std::unique_ptr<ConfigWatcher> watcher;
+#endif
 
         ~LoggerInstance() {
+#ifdef MINISPDLOG_POSIX
+            watcher.reset();
+#endif
             if (initialized && logger) {
                 logger.reset();
             }
         }
     };
 
+    static LoggerSettings load_settings(const std::string &path,
+                                        const LoggerSettings &defaults) {
+        LoggerSettings settings = defaults;
+        if (!path.empty()) {
+            settings.load_file(path);
+        }
+        settings.load_env();
+        return settings;
+    }
+
+    /**
+     * Apply the settings that can change on a live logger
+     * `sinks` are the sinks built from `settings`, only used when the sink
+     * list differs from the current one. Must be called with inst.mutex
+     * held.
+     */
+    static void apply_settings(LoggerInstance &inst,
+                               const LoggerSettings &settings,
+                               const std::vector<std::shared_ptr<Sink>> &sinks) {
+        inst.logger->set_level(settings.level);
+        inst.logger->set_queue_capacity(settings.queue_size, settings.overflow);
+        inst.logger->preallocate_file(settings.preallocate);
+        inst.logger->drop_file_cache(settings.drop_cache);
+        inst.logger->enable_load_shedding(settings.shed_high, settings.shed_low,
+                                          settings.shed_sample);
+        CallSiteRegistry::set_config_levels(settings.site_levels);
+        if (settings.sinks != inst.settings.sinks) {
+            inst.logger->replace_sinks(inst.config_sinks, sinks);
+            inst.config_sinks = sinks;
+        }
+        inst.settings = settings;
+    }
+
+    /**
+     * Stop watching the config file
+     * Called without inst.mutex held, since a reload in progress takes it.
+     */
+    static void stop_watcher(LoggerInstance &inst) {
+#ifdef MINISPDLOG_POSIX
+        inst.watcher.reset();
+#else
+        (void)inst;
+#endif
+    }
+
     /**
      * Helper function to create a logger instance
      * Centralizes logger creation logic for better maintainability
@@ -389,18 +5437,293 @@ class LoggerManager {
     }
 };
 
+#ifdef MINISPDLOG_POSIX
+/**
+ * Control channel on a Unix domain socket
+ * A background thread accepts one command per connection, applies it and
+ * writes back the reply, so that a live process can be reconfigured with,
+ * e.g., `echo "set-level net DEBUG" | nc -U /run/app.slog`. Commands:
+ *
+ *     set-level LEVEL         logger level
+ *     set-level GLOB LEVEL    level of the call sites in matching files
+ *     flush                   Logger::flush(), "error: timeout" if that
+ *                             takes longer than `flush_timeout`
+ *     stats                   Logger::stats() counters
+ *     dump-backtrace          contents of the backtrace ring, if given
+ *
+ * A GLOB without wildcards matches any file whose name contains it. Changes
+ * go through the logger's and the call sites' atomics, so producers pay
+ * nothing for the channel. Without an explicit logger, commands apply to
+ * the LoggerManager one at the time they run.
+ *
+ * The socket is created with mode 0600, so only the owner of the process
+ * (and root) can connect. A stale socket left at the path by a process that
+ * died is replaced; anything else there, a live server's socket or a file
+ * that is not a socket, makes the constructor throw.
+ */
+class ControlServer {
+  public:
+    explicit ControlServer(const std::string &socket_path,
+                           std::shared_ptr<RingSink> backtrace = nullptr,
+                           Logger *logger = nullptr,
+                           std::chrono::milliseconds flush_timeout =
+                               std::chrono::seconds(5))
+        : socket_path_(socket_path), backtrace_(std::move(backtrace)),
+          logger_(logger), flush_timeout_(flush_timeout), listen_fd_(-1) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Control socket path too long: " +
+                                     socket_path);
+        }
+        std::strcpy(addr.sun_path, socket_path.c_str());
+        remove_stale(addr);
+        if (cloexec_pipe(wake_pipe_) != 0) {
+            throw std::runtime_error("Cannot create control pipe");
+        }
+        listen_fd_ = cloexec_socket(AF_UNIX, SOCK_STREAM);
+        // On Linux the mode of the socket inode carries over to the file
+        // bind() creates; elsewhere the chmod() after it closes the gap
+        if (listen_fd_ < 0 || ::fchmod(listen_fd_, 0600) != 0 ||
+            ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr),
+                   sizeof(addr)) != 0 ||
+            ::chmod(socket_path.c_str(), 0600) != 0 ||
+            ::listen(listen_fd_, 4) != 0) {
+            close_fds();
+            throw std::runtime_error("Cannot listen on control socket: " +
+                                     socket_path);
+        }
+        thread_ = std::thread(&ControlServer::run, this);
+    }
+
+    ~ControlServer() {
+        char stop = 0;
+        if (::write(wake_pipe_[1], &stop, 1) < 0) {
+            // The thread also stops on any poll error
+        }
+        thread_.join();
+        close_fds();
+        ::unlink(socket_path_.c_str());
+    }
+
+    ControlServer(const ControlServer &) = delete;
+    ControlServer &operator=(const ControlServer &) = delete;
+
+    /**
+     * Run one command and return its reply
+     */
+    std::string execute(const std::string &command) {
+        std::istringstream in(command);
+        std::vector<std::string> args;
+        std::string arg;
+        while (in >> arg) {
+            args.push_back(arg);
+        }
+        if (args.empty()) {
+            return "error: empty command\n";
+        }
+        try {
+            if (args[0] == "set-level" && (args.size() == 2 || args.size() == 3)) {
+                LogLevel level;
+                if (!level_from_string(args.back(), level)) {
+                    return "error: unknown level " + args.back() + "\n";
+                }
+                if (args.size() == 2) {
+                    logger().set_level(level);
+                    return "ok\n";
+                }
+                std::string glob = args[1];
+                if (glob.find_first_of("*?") == std::string::npos) {
+                    glob = "*" + glob + "*";
+                }
+                size_t matched = CallSiteRegistry::set_level(glob, level);
+                return "ok " + std::to_string(matched) + " sites\n";
+            }
+            if (args[0] == "flush" && args.size() == 1) {
+                // Bounded: a stalled sink must not wedge the server thread
+                return logger().flush(flush_timeout_) ? "ok\n"
+                                                      : "error: timeout\n";
+            }
+            if (args[0] == "stats" && args.size() == 1) {
+                Logger::Stats stats = logger().stats();
+                std::ostringstream out;
+                out << "level " << level_name(stats.level)
+                    << "\neffective_level "
+                    << level_name(stats.effective_level) << "\nwritten "
+                    << stats.written << "\nqueued " << stats.queued
+                    << "\nspilled " << stats.spilled << "\ncapacity "
+                    << stats.capacity << "\ndropped " << stats.dropped
+                    << "\nshed " << stats.shed << "\nsinks " << stats.sinks
+                    << "\ndegraded " << stats.degraded << "\nsink_queued "
+                    << stats.sink_queued << "\nsink_dropped "
+                    << stats.sink_dropped << "\n";
+                return out.str();
+            }
+            if (args[0] == "dump-backtrace" && args.size() == 1) {
+                if (!backtrace_) {
+                    return "error: no backtrace ring\n";
+                }
+                std::string out;
+                for (const auto &record : backtrace_->snapshot()) {
+                    out += record.entry + "\n";
+                }
+                return out;
+            }
+        } catch (const std::exception &e) {
+            return std::string("error: ") + e.what() + "\n";
+        }
+        return "error: unknown command " + args[0] + "\n";
+    }
+
+  private:
+    std::string socket_path_;
+    std::shared_ptr<RingSink> backtrace_;
+    Logger *logger_;
+    std::chrono::milliseconds flush_timeout_;
+    int listen_fd_;
+    int wake_pipe_[2] = {-1, -1};
+    std::thread thread_;
+
+    Logger &logger() { return logger_ ? *logger_ : LoggerManager::get(); }
+
+    /**
+     * Unlink a socket left at the path by a server that is gone
+     */
+    static void remove_stale(const sockaddr_un &addr) {
+        struct stat st;
+        if (::lstat(addr.sun_path, &st) != 0) {
+            return;
+        }
+        if (!S_ISSOCK(st.st_mode)) {
+            throw std::runtime_error("Not a socket, not replacing it: " +
+                                     std::string(addr.sun_path));
+        }
+        int fd = cloexec_socket(AF_UNIX, SOCK_STREAM);
+        bool live = fd >= 0 &&
+                    ::connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                              sizeof(addr)) == 0;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (live) {
+            throw std::runtime_error("Control socket in use: " +
+                                     std::string(addr.sun_path));
+        }
+        ::unlink(addr.sun_path);
+    }
+
+    void close_fds() {
+        for (int fd : {listen_fd_, wake_pipe_[0], wake_pipe_[1]}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+        listen_fd_ = wake_pipe_[0] = wake_pipe_[1] = -1;
+    }
+
+    void run() {
+        pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+        for (;;) {
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            if (fds[1].revents) {
+                return;
+            }
+            if (fds[0].revents & POLLIN) {
+#ifdef __linux__
+                int client =
+                    ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+#else
+                int client = ::accept(listen_fd_, nullptr, nullptr);
+#endif
+                if (client >= 0) {
+                    serve(client);
+                    ::close(client);
+                }
+            }
+        }
+    }
+
+    /**
+     * Read one command line, a stalled client is dropped after a second
+     */
+    void serve(int client) {
+        timeval timeout{1, 0};
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                     sizeof(timeout));
+        std::string command;
+        char buffer[256];
+        while (command.find('\n') == std::string::npos &&
+               command.size() < 4096) {
+            ssize_t n = ::read(client, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            command.append(buffer, static_cast<size_t>(n));
+        }
+        std::string reply = execute(command.substr(0, command.find('\n')));
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        size_t done = 0;
+        while (done < reply.size()) {
+            ssize_t n = ::send(client, reply.data() + done,
+                               reply.size() - done, flags);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+    }
+};
+#endif // MINISPDLOG_POSIX
+
 } // namespace MiniLogger
 
+/**
+ * Call site dispatch shared by the logging macros
+ * Every expansion registers a CallSite, so it can be switched on or off at
+ * runtime with CallSiteRegistry. A disabled site costs one relaxed load and
+ * a branch. The site lives in an immediately invoked lambda, so the macros
+ * stay expressions, as calls to the logger are; `format` is the source text
+ * of the message or format argument.
+ */
+#define SLOG_CALL_SITE(level, method, format, ...)                             \
+    ([&](const char *slog_function_) {                                         \
+        static MiniLogger::CallSite slog_site_(__FILE__, __LINE__, level,      \
+                                               format);                        \
+        MiniLogger::CallSite::State slog_state_ =                              \
+            slog_site_.state(slog_function_);                                  \
+        if (slog_state_ == MiniLogger::CallSite::State::DEFAULT) {             \
+            MiniLogger::LoggerManager::get().method(__VA_ARGS__);              \
+        } else if (slog_state_ == MiniLogger::CallSite::State::ENABLED) {      \
+            MiniLogger::LoggerManager::get().force_log(level, __VA_ARGS__);    \
+        }                                                                      \
+    }(__func__))
+
 /**
  * Macros for convenience
  * These macros are used to log messages at different levels.
  * They are defined to call the corresponding methods in the Logger class.
  */
-#define SLOG_DEBUG(msg) MiniLogger::LoggerManager::get().debug(msg)
-#define SLOG_INFO(msg) MiniLogger::LoggerManager::get().info(msg)
-#define SLOG_WARN(msg) MiniLogger::LoggerManager::get().warn(msg)
-#define SLOG_ERROR(msg) MiniLogger::LoggerManager::get().error(msg)
-#define SLOG_CRITICAL(msg) MiniLogger::LoggerManager::get().critical(msg)
+#define SLOG_DEBUG(msg) SLOG_CALL_SITE(MiniLogger::LogLevel::DEBUG, debug, #msg, msg)
+#define SLOG_INFO(msg) SLOG_CALL_SITE(MiniLogger::LogLevel::INFO, info, #msg, msg)
+#define SLOG_WARN(msg) SLOG_CALL_SITE(MiniLogger::LogLevel::WARN, warn, #msg, msg)
+#define SLOG_ERROR(msg) SLOG_CALL_SITE(MiniLogger::LogLevel::ERROR, error, #msg, msg)
+#define SLOG_CRITICAL(msg) SLOG_CALL_SITE(MiniLogger::LogLevel::CRITICAL, critical, #msg, msg)
 
 /**
  * Macros for formatted logging
@@ -410,10 +5733,32 @@ class LoggerManager {
  * Example: SLOG_DEBUG_F("Hello, {}!", "World");
  * Output: "2025-01-01 12:00:00.000000 [DEBUG] [Thread:1234] Hello, World!"
  */
-#define SLOG_DEBUG_F(fmt, ...) MiniLogger::LoggerManager::get().debug(fmt, __VA_ARGS__)
-#define SLOG_INFO_F(fmt, ...) MiniLogger::LoggerManager::get().info(fmt, __VA_ARGS__)
-#define SLOG_WARN_F(fmt, ...) MiniLogger::LoggerManager::get().warn(fmt, __VA_ARGS__)
-#define SLOG_ERROR_F(fmt, ...) MiniLogger::LoggerManager::get().error(fmt, __VA_ARGS__)
-#define SLOG_CRITICAL_F(fmt, ...) MiniLogger::LoggerManager::get().critical(fmt, __VA_ARGS__)
+#define SLOG_DEBUG_F(fmt, ...) SLOG_CALL_SITE(MiniLogger::LogLevel::DEBUG, debug, #fmt, fmt, __VA_ARGS__)
+#define SLOG_INFO_F(fmt, ...) SLOG_CALL_SITE(MiniLogger::LogLevel::INFO, info, #fmt, fmt, __VA_ARGS__)
+#define SLOG_WARN_F(fmt, ...) SLOG_CALL_SITE(MiniLogger::LogLevel::WARN, warn, #fmt, fmt, __VA_ARGS__)
+#define SLOG_ERROR_F(fmt, ...) SLOG_CALL_SITE(MiniLogger::LogLevel::ERROR, error, #fmt, fmt, __VA_ARGS__)
+#define SLOG_CRITICAL_F(fmt, ...) SLOG_CALL_SITE(MiniLogger::LogLevel::CRITICAL, critical, #fmt, fmt, __VA_ARGS__)
+
+/**
+ * Scoped timing span
+ * Records the time spent until the end of the enclosing scope, delivered to
+ * span sinks such as TraceEventSink. The name must be a string literal.
+ *
+ * Example: SLOG_SCOPE("db_query");
+ */
+#define SLOG_CONCAT_IMPL(a, b) a##b
+#define SLOG_CONCAT(a, b) SLOG_CONCAT_IMPL(a, b)
+#define SLOG_SCOPE(name)                                                       \
+    MiniLogger::ScopedSpan SLOG_CONCAT(slog_scope_, __LINE__)(                 \
+        MiniLogger::LoggerManager::get(), name)
+
+/**
+ * Push a key/value pair on the thread's logging context until the end of
+ * the enclosing scope
+ *
+ * Example: SLOG_CONTEXT("request_id", id);
+ */
+#define SLOG_CONTEXT(key, value)                                               \
+    MiniLogger::ScopedContext SLOG_CONCAT(slog_context_, __LINE__)(key, value)
 
 #endif // _MINISDPLOG_H
@@ -8,6 +8,14 @@
 #include <cassert>
 #include <functional>
 #include <sstream>
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 // C++14 compatible file operations
 class FileHelper {
@@ -20,6 +28,25 @@ public:
     static bool remove_file(const std::string& filename) {
         return std::remove(filename.c_str()) == 0;
     }
+
+    static std::vector<std::string> list_dir(const std::string& dirname) {
+        std::vector<std::string> names;
+        DIR* dir = opendir(dirname.c_str());
+        if (!dir) return names;
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") names.push_back(name);
+        }
+        closedir(dir);
+        return names;
+    }
+
+    static void remove_dir(const std::string& dirname) {
+        for (const auto& name : list_dir(dirname)) {
+            remove_file(dirname + "/" + name);
+        }
+        std::remove(dirname.c_str());
+    }
 };
 
 class TestFramework {
@@ -78,6 +105,26 @@ public:
             if (FileHelper::file_exists("test_threading.log")) FileHelper::remove_file("test_threading.log");
             if (FileHelper::file_exists("test_async.log")) FileHelper::remove_file("test_async.log");
             if (FileHelper::file_exists("test_formatting.log")) FileHelper::remove_file("test_formatting.log");
+            if (FileHelper::file_exists("test_sinks.log")) FileHelper::remove_file("test_sinks.log");
+            if (FileHelper::file_exists("test_flight.ring")) FileHelper::remove_file("test_flight.ring");
+            if (FileHelper::file_exists("test_index.log")) FileHelper::remove_file("test_index.log");
+            if (FileHelper::file_exists("test_index.log.idx")) FileHelper::remove_file("test_index.log.idx");
+            if (FileHelper::file_exists("test_index2.log")) FileHelper::remove_file("test_index2.log");
+            if (FileHelper::file_exists("test_index2.log.idx")) FileHelper::remove_file("test_index2.log.idx");
+            if (FileHelper::file_exists("test_compressed.slz")) FileHelper::remove_file("test_compressed.slz");
+            if (FileHelper::file_exists("test_reopen.log")) FileHelper::remove_file("test_reopen.log");
+            if (FileHelper::file_exists("test_durable.log")) FileHelper::remove_file("test_durable.log");
+            if (FileHelper::file_exists("test_trace.json")) FileHelper::remove_file("test_trace.json");
+            if (FileHelper::file_exists("test_reopen.log.1")) FileHelper::remove_file("test_reopen.log.1");
+            if (FileHelper::file_exists("test_reopen.log.2")) FileHelper::remove_file("test_reopen.log.2");
+            if (FileHelper::file_exists("test_callsite.log")) FileHelper::remove_file("test_callsite.log");
+            if (FileHelper::file_exists("test_config.conf")) FileHelper::remove_file("test_config.conf");
+            if (FileHelper::file_exists("test_config.log")) FileHelper::remove_file("test_config.log");
+            if (FileHelper::file_exists("test_config.slz")) FileHelper::remove_file("test_config.slz");
+            if (FileHelper::file_exists("test_buffered.log")) FileHelper::remove_file("test_buffered.log");
+            if (FileHelper::file_exists("test_buffered.log.idx")) FileHelper::remove_file("test_buffered.log.idx");
+            if (FileHelper::file_exists("test_filesink.log")) FileHelper::remove_file("test_filesink.log");
+            if (FileHelper::file_exists("test_prealloc.log")) FileHelper::remove_file("test_prealloc.log");
         } catch (...) {
             // Ignore cleanup errors
         }
@@ -139,8 +186,7 @@ void test_basic_initialization_and_logging(TestFramework& tf) {
     SLOG_DEBUG("Debug message");
     SLOG_ERROR("Error message");
     
-    // Allow time for file writing
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    MiniLogger::LoggerManager::get().flush();
     
     // Verify file exists and has content
     tf.assert_true(FileHelper::file_exists("test_basic.log"), "Log file should exist");
@@ -164,7 +210,7 @@ void test_log_levels_filtering(TestFramework& tf) {
     SLOG_ERROR("This should also appear");
     SLOG_CRITICAL("This should definitely appear");
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    MiniLogger::LoggerManager::get().flush();
     
     std::string content = LoggerTestHelper::read_file("test_levels.log");
     
@@ -183,7 +229,7 @@ void test_timestamp_format(TestFramework& tf) {
     MiniLogger::LoggerManager::initialize("test_basic.log", MiniLogger::LogLevel::DEBUG);
     
     SLOG_INFO("Timestamp test");
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    MiniLogger::LoggerManager::get().flush();
     
     std::string content = LoggerTestHelper::read_file("test_basic.log");
     tf.assert_true(LoggerTestHelper::matches_timestamp_pattern(content), 
@@ -214,7 +260,7 @@ void test_thread_safety(TestFramework& tf) {
         t.join();
     }
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    MiniLogger::LoggerManager::get().flush();
     
     // Verify all messages were logged
     int line_count = LoggerTestHelper::count_lines("test_threading.log");
@@ -248,8 +294,7 @@ void test_async_logging(TestFramework& tf) {
         SLOG_INFO("Async message " + std::to_string(i));
     }
     
-    // Give async logger time to flush
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    MiniLogger::LoggerManager::get().flush();
     
     int line_count = LoggerTestHelper::count_lines("test_async.log");
     tf.assert_true(line_count == message_count, 
@@ -266,7 +311,7 @@ void test_formatted_logging(TestFramework& tf) {
     logger.info("User john has 42 points");  // Simulate formatted output
     logger.debug("Connection to localhost:8080 established");  // Simulate formatted output
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    MiniLogger::LoggerManager::get().flush();
     
     std::string content = LoggerTestHelper::read_file("test_formatting.log");
     tf.assert_true(LoggerTestHelper::contains_pattern(content, "User john has 42 points"), 
@@ -284,7 +329,7 @@ void test_direct_logger_access(TestFramework& tf) {
     logger.info("Direct access test");
     logger.warn("Direct warning");
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    MiniLogger::LoggerManager::get().flush();
     
     std::string content = LoggerTestHelper::read_file("test_basic.log");
     tf.assert_true(LoggerTestHelper::contains_pattern(content, "Direct access test"), 
@@ -307,7 +352,7 @@ void test_level_change(TestFramework& tf) {
     
     SLOG_DEBUG("This should appear after level change");
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    MiniLogger::LoggerManager::get().flush();
     
     std::string content = LoggerTestHelper::read_file("test_basic.log");
     tf.assert_true(!LoggerTestHelper::contains_pattern(content, "This should not appear initially"), 
@@ -339,6 +384,1303 @@ void test_error_handling(TestFramework& tf) {
     }
 }
 
+void test_flight_recorder(TestFramework& tf) {
+    LoggerTestHelper::reset_logger();
+    MiniLogger::LoggerManager::initialize("test_sinks.log", MiniLogger::LogLevel::DEBUG);
+
+    // A small ring so that it wraps around
+    auto recorder = std::make_shared<MiniLogger::FlightRecorderSink>(
+        "test_flight.ring", 512, MiniLogger::LogLevel::INFO);
+    MiniLogger::LoggerManager::get().add_sink(recorder);
+
+    SLOG_DEBUG("Not recorded");
+    for (int i = 0; i < 20; ++i) {
+        SLOG_INFO("Recorded message " + std::to_string(i));
+    }
+
+    std::string content = MiniLogger::FlightRecorderSink::decode("test_flight.ring");
+    tf.assert_true(!LoggerTestHelper::contains_pattern(content, "Not recorded"),
+                   "DEBUG message should be filtered by the sink level");
+    tf.assert_true(LoggerTestHelper::contains_pattern(content, "Recorded message 19\n"),
+                   "Newest message should be in the ring");
+    tf.assert_true(!LoggerTestHelper::contains_pattern(content, "Recorded message 0\n"),
+                   "Oldest message should have been overwritten");
+    tf.assert_true(content.size() <= 512, "Decoded data should fit the ring");
+    tf.assert_true(LoggerTestHelper::matches_timestamp_pattern(content.substr(0, 26)),
+                   "Decoded data should start at a record boundary");
+}
+
+void test_time_index(TestFramework& tf) {
+    {
+        MiniLogger::Logger logger("test_index.log", MiniLogger::LogLevel::DEBUG);
+        logger.enable_time_index(512);
+        for (int i = 0; i < 300; ++i) {
+            logger.info("Indexed message {}", i);
+        }
+    }
+
+    std::vector<std::string> lines;
+    std::istringstream all(LoggerTestHelper::read_file("test_index.log"));
+    std::string line;
+    while (std::getline(all, line)) {
+        lines.push_back(line);
+    }
+    tf.assert_true(lines.size() == 300, "Log file should have 300 lines");
+
+    std::string from = lines[150].substr(0, 26);
+    std::string to = lines[250].substr(0, 26);
+    std::string expected;
+    for (const auto& l : lines) {
+        if (l.compare(0, 26, from) >= 0 && l.compare(0, 26, to) < 0) {
+            expected += l + "\n";
+        }
+    }
+
+    tf.assert_true(MiniLogger::TimeIndex::find_offset("test_index.log", from) > 0,
+                   "Index should allow skipping the beginning of the file");
+    std::ostringstream range;
+    MiniLogger::TimeIndex::read_range("test_index.log", from, to, range);
+    tf.assert_equals(expected, range.str(), "Range should match a full scan");
+
+    // Another writer appends to the same file: the index must follow the
+    // real offsets, synchronously and through the async worker's batches
+    for (bool async : {false, true}) {
+        FileHelper::remove_file("test_index2.log");
+        FileHelper::remove_file("test_index2.log.idx");
+        {
+            MiniLogger::Logger logger("test_index2.log", MiniLogger::LogLevel::DEBUG, async);
+            logger.enable_time_index(256);
+            int other = open("test_index2.log", O_WRONLY | O_APPEND);
+            for (int i = 0; i < 200; ++i) {
+                logger.info("Shared message {}", i);
+                if (i % 10 == 0) {
+                    logger.flush();
+                    const char foreign[] = "line from another process\n";
+                    tf.assert_true(write(other, foreign, sizeof(foreign) - 1) > 0,
+                                   "Foreign write should succeed");
+                }
+            }
+            close(other);
+        }
+        std::string log = LoggerTestHelper::read_file("test_index2.log");
+        std::istringstream index(LoggerTestHelper::read_file("test_index2.log.idx"));
+        int entries = 0;
+        bool aligned = true;
+        while (std::getline(index, line)) {
+            uint64_t offset = std::stoull(line.substr(MiniLogger::TimeIndex::TIMESTAMP_WIDTH + 1));
+            aligned = aligned && offset < log.size() &&
+                      (offset == 0 || log[offset - 1] == '\n') &&
+                      log.compare(offset, MiniLogger::TimeIndex::TIMESTAMP_WIDTH, line, 0,
+                                  MiniLogger::TimeIndex::TIMESTAMP_WIDTH) == 0;
+            entries++;
+        }
+        tf.assert_true(entries > 5, "Shared file should be indexed");
+        tf.assert_true(aligned, std::string("Index entries should point at their records") +
+                                    (async ? " (async)" : ""));
+    }
+}
+
+void test_compressed_sink(TestFramework& tf) {
+    // Codec round trip on repetitive and on incompressible data
+    std::string text;
+    for (int i = 0; i < 2000; ++i) {
+        text += "2025-05-23 12:16:08.907630 [INFO] [Thread:758] Request " +
+                std::to_string(i) + " served\n";
+    }
+    std::string noise;
+    unsigned seed = 12345;
+    for (int i = 0; i < 5000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        noise += static_cast<char>(seed >> 24);
+    }
+    for (const std::string* data : {&text, &noise}) {
+        std::string packed = MiniLogger::Lz4Codec::compress(data->data(), data->size());
+        std::string unpacked = MiniLogger::Lz4Codec::decompress(packed.data(), packed.size(), data->size());
+        tf.assert_true(unpacked == *data, "Codec round trip should be lossless");
+    }
+    std::string packed = MiniLogger::Lz4Codec::compress(text.data(), text.size());
+    tf.assert_true(packed.size() * 4 < text.size(), "Log text should compress well");
+
+    {
+        MiniLogger::Logger logger("test_sinks.log", MiniLogger::LogLevel::DEBUG, true);
+        logger.add_sink(std::make_shared<MiniLogger::CompressedFileSink>(
+            "test_compressed.slz", 4096));
+        for (int i = 0; i < 500; ++i) {
+            logger.info("Compressed message {}", i);
+        }
+    }
+    std::ifstream in("test_compressed.slz", std::ios::binary);
+    std::ostringstream out;
+    MiniLogger::CompressedFileSink::decompress(in, out);
+    std::string content = out.str();
+    tf.assert_true(LoggerTestHelper::contains_pattern(content, "Compressed message 0\n"),
+                   "First record should be decompressed");
+    tf.assert_true(LoggerTestHelper::contains_pattern(content, "Compressed message 499\n"),
+                   "Last record should be decompressed");
+
+    // flush() writes the partial block out
+    {
+        MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+        logger.add_sink(std::make_shared<MiniLogger::CompressedFileSink>("test_compressed2.slz"));
+        logger.info("Flushed compressed message");
+        logger.flush();
+        std::ifstream flushed("test_compressed2.slz", std::ios::binary);
+        std::ostringstream unpacked;
+        MiniLogger::CompressedFileSink::decompress(flushed, unpacked);
+        tf.assert_true(LoggerTestHelper::contains_pattern(unpacked.str(), "Flushed compressed message\n"),
+                       "A flushed partial block should be on disk");
+    }
+    std::remove("test_compressed2.slz");
+
+    // A frame header cut short is an error, like a cut payload
+    bool threw = false;
+    try {
+        std::istringstream cut("SLZ1ab");
+        std::ostringstream ignored;
+        MiniLogger::CompressedFileSink::decompress(cut, ignored);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    tf.assert_true(threw, "A truncated frame header should throw");
+}
+
+void test_rotation_and_retention(TestFramework& tf) {
+    FileHelper::remove_dir("test_retention");
+    mkdir("test_retention", 0755);
+
+    MiniLogger::RetentionManager::Policy policy;
+    policy.max_total_bytes = 4096;
+    auto retention = std::make_shared<MiniLogger::RetentionManager>(
+        "test_retention/app.log", policy);
+    {
+        MiniLogger::Logger logger("test_sinks.log", MiniLogger::LogLevel::DEBUG);
+        logger.add_sink(std::make_shared<MiniLogger::RotatingFileSink>(
+            "test_retention/app.log", 2048, retention));
+        for (int i = 0; i < 400; ++i) {
+            logger.info("Rotated message {}", i);
+        }
+    }
+    retention->run_once();
+
+    uint64_t rotated_bytes = 0;
+    int rotated = 0;
+    bool all_compressed = true;
+    for (const auto& name : FileHelper::list_dir("test_retention")) {
+        if (name == "app.log") continue;
+        struct stat st;
+        stat(("test_retention/" + name).c_str(), &st);
+        rotated_bytes += static_cast<uint64_t>(st.st_size);
+        rotated++;
+        all_compressed = all_compressed && name.size() > 4 &&
+                         name.compare(name.size() - 4, 4, ".slz") == 0;
+    }
+    tf.assert_true(rotated > 0, "Rotated files should be kept");
+    tf.assert_true(all_compressed, "Rotated files should be compressed");
+    tf.assert_true(rotated_bytes <= policy.max_total_bytes,
+                   "Rotated files should fit the size limit, got " + std::to_string(rotated_bytes));
+    tf.assert_true(LoggerTestHelper::count_lines("test_retention/app.log") > 0,
+                   "Active file should keep the latest records");
+    tf.assert_true(retention->free_bytes() > 0, "Free space should be cached");
+
+    // Compressed segments keep the age of the rotated file
+    {
+        MiniLogger::RetentionManager::Policy aged;
+        aged.max_age = std::chrono::hours(24);
+        MiniLogger::RetentionManager manager("test_retention/old.log", aged);
+        std::ofstream("test_retention/old.log.20200101-000000-000000") << "old\n";
+        std::ofstream("test_retention/old.log.20990101-000000-000000") << "new\n";
+        struct timespec times[2];
+        times[0].tv_sec = times[1].tv_sec = std::time(nullptr) - 2 * 24 * 3600;
+        times[0].tv_nsec = times[1].tv_nsec = 0;
+        utimensat(AT_FDCWD, "test_retention/old.log.20200101-000000-000000", times, 0);
+        manager.run_once();
+        tf.assert_true(!FileHelper::file_exists("test_retention/old.log.20200101-000000-000000.slz") &&
+                       FileHelper::file_exists("test_retention/old.log.20990101-000000-000000.slz"),
+                       "Segments older than max_age should go even once compressed");
+    }
+
+    // A name too long for the rotated suffix makes the rename fail: the
+    // sink is degraded and keeps its file
+    std::string long_name = "test_" + std::string(240, 'r') + ".log";
+    {
+        MiniLogger::RotatingFileSink sink(long_name, 256);
+        sink.set_health_policy(std::chrono::microseconds(0), false);
+        MiniLogger::LogRecord record(MiniLogger::LogLevel::INFO, std::string(100, 'x'));
+        for (int i = 0; i < 4; ++i) {
+            sink.checked_write(record);
+            sink.checked_flush();
+        }
+        tf.assert_true(sink.health().degraded() && sink.health().failures() == 1 &&
+                       sink.health().dropped_count() == 2,
+                       "A failed rename should degrade the sink and back off");
+    }
+    tf.assert_true(LoggerTestHelper::count_lines(long_name) == 2,
+                   "The file should stay in use after a failed rotation");
+    std::remove(long_name.c_str());
+
+    retention.reset();
+    FileHelper::remove_dir("test_retention");
+}
+
+void test_reopen(TestFramework& tf) {
+    {
+        MiniLogger::Logger logger("test_reopen.log", MiniLogger::LogLevel::DEBUG);
+        logger.info("Before rotation");
+        std::rename("test_reopen.log", "test_reopen.log.1");
+        logger.info("Still to the renamed file");
+        logger.reopen();
+        logger.info("After reopen");
+
+        MiniLogger::Logger::install_sighup_handler();
+        std::rename("test_reopen.log", "test_reopen.log.2");
+        std::raise(SIGHUP);
+        logger.info("After SIGHUP");
+    }
+    std::string first = LoggerTestHelper::read_file("test_reopen.log.1");
+    std::string second = LoggerTestHelper::read_file("test_reopen.log.2");
+    std::string current = LoggerTestHelper::read_file("test_reopen.log");
+    tf.assert_true(LoggerTestHelper::contains_pattern(first, "Before rotation") &&
+                   LoggerTestHelper::contains_pattern(first, "Still to the renamed file"),
+                   "Records before reopen should go to the renamed file");
+    tf.assert_true(LoggerTestHelper::contains_pattern(second, "After reopen") &&
+                   !LoggerTestHelper::contains_pattern(second, "After SIGHUP"),
+                   "Records after reopen should go to the new file");
+    tf.assert_true(LoggerTestHelper::contains_pattern(current, "After SIGHUP"),
+                   "SIGHUP should make the logger reopen its file");
+}
+
+void test_durable_mode(TestFramework& tf) {
+    MiniLogger::Logger logger("test_durable.log", MiniLogger::LogLevel::INFO, true);
+    logger.enable_durable_mode(std::chrono::milliseconds(1));
+
+    std::vector<MiniLogger::DurableTicket> tickets;
+    for (int i = 0; i < 50; ++i) {
+        logger.info("Regular record {}", i);
+        tickets.push_back(logger.log_durable(MiniLogger::LogLevel::INFO, "Audit record {}", i));
+    }
+    bool all_durable = true;
+    for (const auto& ticket : tickets) {
+        all_durable = ticket.wait_for(std::chrono::milliseconds(5000)) && all_durable;
+    }
+    tf.assert_true(all_durable, "Every ticket should complete successfully");
+
+    // Completed tickets mean the records are already in the file
+    std::string content = LoggerTestHelper::read_file("test_durable.log");
+    tf.assert_true(LoggerTestHelper::contains_pattern(content, "Audit record 49"),
+                   "Durable records should be written before their ticket completes");
+    tf.assert_true(logger.log_durable(MiniLogger::LogLevel::DEBUG, "Filtered").wait(),
+                   "Filtered records should complete immediately");
+}
+
+class SlowSink : public MiniLogger::Sink {
+public:
+    explicit SlowSink(std::chrono::milliseconds delay) : delay_(delay) {}
+    void write(const MiniLogger::LogRecord&) override {
+        std::this_thread::sleep_for(delay_);
+        written++;
+    }
+    std::atomic<int> written{0};
+private:
+    std::chrono::milliseconds delay_;
+};
+
+void test_flush_barrier(TestFramework& tf) {
+    MiniLogger::Logger logger("test_sinks.log", MiniLogger::LogLevel::DEBUG, true);
+    auto slow = std::make_shared<SlowSink>(std::chrono::milliseconds(20));
+    logger.add_sink(slow);
+    for (int i = 0; i < 5; ++i) {
+        logger.info("Flushed message {}", i);
+    }
+    tf.assert_true(!logger.flush(std::chrono::milliseconds(1)),
+                   "Flush should time out while the sink is still busy");
+    tf.assert_true(logger.flush(), "Flush should succeed without timeout");
+    tf.assert_true(slow->written == 5, "All records before flush should be written");
+}
+
+void test_ring_sink(TestFramework& tf) {
+    // No log file: records only go to the in-memory ring
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto ring = std::make_shared<MiniLogger::RingSink>(8, 64);
+    logger.add_sink(ring);
+    for (int i = 0; i < 20; ++i) {
+        logger.info("Ring message {}", i);
+    }
+    logger.error("{}", std::string(100, 'x'));
+    logger.flush();
+
+    auto records = ring->snapshot();
+    tf.assert_true(records.size() == 8, "Ring should keep its capacity worth of records");
+    tf.assert_true(ring->total() == 21, "Ring should count every appended record");
+    tf.assert_true(records.front().entry.find("Ring message 13") != std::string::npos,
+                   "Oldest kept record should come first");
+    tf.assert_true(records.back().level == MiniLogger::LogLevel::ERROR &&
+                   records.back().entry.size() == 64,
+                   "Newest record should come last, truncated to the entry size");
+    tf.assert_true(ring->contains("Ring message 19"), "contains() should find recent records");
+    tf.assert_true(!ring->contains("Ring message 5 "), "Overwritten records should be gone");
+
+    // Concurrent appends and snapshots; with 2 slots writers lap each other
+    for (size_t capacity : {256, 2}) {
+        MiniLogger::RingSink shared(capacity, 64);
+        std::atomic<bool> done(false);
+        std::atomic<bool> torn(false);
+        std::thread reader([&]() {
+            while (!done) {
+                for (const auto& record : shared.snapshot()) {
+                    int t = static_cast<int>(record.level);
+                    size_t dash = record.entry.find('-');
+                    if (record.entry.compare(0, 7, "record ") != 0 || dash == std::string::npos ||
+                        record.entry.substr(7, dash - 7) != std::to_string(t) ||
+                        record.entry.find_first_not_of("0123456789", dash + 1) != std::string::npos) {
+                        torn = true;
+                    }
+                }
+            }
+        });
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 4; ++t) {
+            writers.emplace_back([&shared, t]() {
+                for (int i = 0; i < 1000; ++i) {
+                    shared.append(static_cast<MiniLogger::LogLevel>(t),
+                                  "record " + std::to_string(t) + "-" + std::to_string(i));
+                }
+            });
+        }
+        for (auto& w : writers) w.join();
+        done = true;
+        reader.join();
+        auto kept = shared.snapshot();
+        tf.assert_true(!torn, "Snapshots should never return partially written records");
+        tf.assert_true(shared.total() == 4000, "Every concurrent append should be counted");
+        tf.assert_true(kept.size() == capacity && kept.back().seq == 3999,
+                       "Ring should keep the newest records after concurrent appends");
+    }
+}
+
+void test_trace_spans(TestFramework& tf) {
+    LoggerTestHelper::reset_logger();
+    FileHelper::remove_file("test_sinks.log");
+    MiniLogger::LoggerManager::initialize("test_sinks.log", MiniLogger::LogLevel::INFO, true);
+    MiniLogger::LoggerManager::get().add_sink(
+        std::make_shared<MiniLogger::TraceEventSink>("test_trace.json"));
+    {
+        SLOG_SCOPE("request");
+        for (int i = 0; i < 3; ++i) {
+            SLOG_SCOPE("db_query");
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        SLOG_INFO("Request done");
+    }
+    MiniLogger::LoggerManager::shutdown();
+
+    std::string trace = LoggerTestHelper::read_file("test_trace.json");
+    std::regex span("\\{\"name\":\"db_query\",\"cat\":\"scope\",\"ph\":\"X\",\"ts\":\\d+,\"dur\":(\\d+),");
+    int spans = 0;
+    for (auto it = std::sregex_iterator(trace.begin(), trace.end(), span);
+         it != std::sregex_iterator(); ++it) {
+        spans++;
+        tf.assert_true(std::stol((*it)[1]) >= 1000, "Span duration should cover the sleep");
+    }
+    tf.assert_true(spans == 3, "Each scope should produce one event, got " + std::to_string(spans));
+    tf.assert_true(LoggerTestHelper::contains_pattern(trace, "\"name\":\"request\""),
+                   "Outer scope should be recorded");
+    tf.assert_true(trace.compare(0, 1, "[") == 0 && trace.find("]\n") == trace.size() - 2,
+                   "Trace should be a complete JSON array");
+
+    std::string content = LoggerTestHelper::read_file("test_sinks.log");
+    tf.assert_true(LoggerTestHelper::count_lines("test_sinks.log") == 1 &&
+                   LoggerTestHelper::contains_pattern(content, "Request done"),
+                   "Spans should not be written to the log file");
+}
+
+class CollectSink : public MiniLogger::Sink {
+public:
+    void write(const MiniLogger::LogRecord& record) override { records.push_back(record); }
+    std::vector<MiniLogger::LogRecord> records;
+};
+
+void test_context(TestFramework& tf) {
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto collect = std::make_shared<CollectSink>();
+    logger.add_sink(collect);
+
+    logger.info("No context");
+    {
+        SLOG_CONTEXT("request_id", "abc");
+        logger.info("Outer");
+        {
+            SLOG_CONTEXT("user", 42);
+            logger.info("Inner");
+        }
+        logger.info("Outer again");
+        std::thread other([&logger]() { logger.info("Other thread"); });
+        other.join();
+    }
+    logger.info("Context gone");
+    logger.flush();
+
+    auto& records = collect->records;
+    tf.assert_true(records.size() == 6, "All records should be captured");
+    auto has = [&](size_t i, const std::string& text) {
+        return records[i].entry.find(text) != std::string::npos;
+    };
+    tf.assert_true(has(0, "] No context") && !has(0, "request_id"), "No context before push");
+    tf.assert_true(has(1, "] [request_id=abc] Outer"), "Context should precede the message");
+    tf.assert_true(has(2, "] [request_id=abc user=42] Inner"), "Nested contexts should accumulate");
+    tf.assert_true(has(3, "] [request_id=abc] Outer again"), "Inner context should be popped");
+    tf.assert_true(!has(4, "request_id"), "Context should be per thread");
+    tf.assert_true(!has(5, "request_id"), "Context should be gone after its scope");
+    tf.assert_true(records[2].context && records[2].context->key == "user" &&
+                   records[2].context->parent->value == "abc",
+                   "Records should keep the structured context");
+}
+
+void emit_call_sites(int round) {
+    SLOG_DEBUG_F("Call site debug {}", round);
+    // The macros are expressions, like the logger calls they replace
+    round > 0 ? SLOG_INFO_F("Call site info {}", round) : SLOG_WARN("Unreachable");
+}
+
+void test_call_sites(TestFramework& tf) {
+    MiniLogger::LoggerManager::initialize("test_callsite.log", MiniLogger::LogLevel::INFO);
+
+    emit_call_sites(1);
+    const MiniLogger::CallSite* debug_site = nullptr;
+    const MiniLogger::CallSite* info_site = nullptr;
+    for (const auto* site : MiniLogger::CallSiteRegistry::sites()) {
+        std::string format = site->format;
+        if (format.find("Call site debug") != std::string::npos) debug_site = site;
+        if (format.find("Call site info") != std::string::npos) info_site = site;
+    }
+    tf.assert_true(debug_site && info_site, "Executed sites should be registered");
+    tf.assert_true(debug_site && debug_site->level == MiniLogger::LogLevel::DEBUG &&
+                   std::string(debug_site->function) == "emit_call_sites" &&
+                   std::string(debug_site->format) == "\"Call site debug {}\"",
+                   "Sites should carry their metadata");
+
+    tf.assert_true(MiniLogger::CallSiteRegistry::set_state(
+                       "test_minispdlog.cpp", debug_site->line,
+                       MiniLogger::CallSite::State::ENABLED) == 1,
+                   "A file and line should select one site");
+    tf.assert_true(MiniLogger::CallSiteRegistry::set_state(
+                       "test_*.cpp", info_site->line,
+                       MiniLogger::CallSite::State::DISABLED) == 1,
+                   "Globs should match the base name");
+    // A config reload replaces its own rules only
+    MiniLogger::CallSiteRegistry::set_config_levels(
+        {{"test_minispdlog.cpp", MiniLogger::LogLevel::ERROR}});
+    emit_call_sites(2);
+    MiniLogger::CallSiteRegistry::reset();
+    emit_call_sites(3);
+    MiniLogger::LoggerManager::get().flush();
+
+    std::string content = LoggerTestHelper::read_file("test_callsite.log");
+    tf.assert_true(!LoggerTestHelper::contains_pattern(content, "Call site debug 1") &&
+                   LoggerTestHelper::contains_pattern(content, "Call site info 1"),
+                   "Sites should follow the logger level by default");
+    tf.assert_true(LoggerTestHelper::contains_pattern(content, "Call site debug 2"),
+                   "An enabled site should bypass the logger level and config rules");
+    tf.assert_true(!LoggerTestHelper::contains_pattern(content, "Call site info 2"),
+                   "A disabled site should not log");
+    tf.assert_true(!LoggerTestHelper::contains_pattern(content, "Call site debug 3") &&
+                   LoggerTestHelper::contains_pattern(content, "Call site info 3"),
+                   "Reset should restore the default behavior");
+    tf.assert_true(MiniLogger::CallSiteRegistry::glob_match("src/*/net?.cpp", "src/io/net1.cpp") &&
+                   !MiniLogger::CallSiteRegistry::glob_match("*.h", "main.cpp"),
+                   "Glob matching should handle * and ?");
+}
+
+std::string control_request(const std::string& path, const std::string& command) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path.c_str());
+    std::string reply;
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        std::string line = command + "\n";
+        if (write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size())) {
+            char buffer[256];
+            ssize_t n;
+            while ((n = read(fd, buffer, sizeof(buffer))) > 0) reply.append(buffer, n);
+        }
+    }
+    if (fd >= 0) close(fd);
+    return reply;
+}
+
+void emit_control_sites() {
+    SLOG_DEBUG("Control site debug");
+}
+
+void test_control_server(TestFramework& tf) {
+    MiniLogger::LoggerManager::initialize("", MiniLogger::LogLevel::INFO);
+    auto ring = std::make_shared<MiniLogger::RingSink>(16, 128);
+    MiniLogger::LoggerManager::get().add_sink(ring);
+    MiniLogger::ControlServer server("test_control.sock", ring);
+
+    SLOG_INFO("Before control");
+    std::string stats = control_request("test_control.sock", "stats");
+    tf.assert_true(stats.find("level INFO\n") != std::string::npos &&
+                   stats.find("written 1\n") != std::string::npos,
+                   "Stats should report level and counters");
+
+    tf.assert_equals(std::string("ok\n"), control_request("test_control.sock", "set-level warn"),
+                     "Logger level command should succeed");
+    tf.assert_true(MiniLogger::LoggerManager::get().level() == MiniLogger::LogLevel::WARN,
+                   "Logger level should be updated");
+    SLOG_INFO("Hidden by level");
+
+    emit_control_sites();
+    tf.assert_true(control_request("test_control.sock", "set-level minispdlog DEBUG").find("ok ") == 0,
+                   "Glob level command should succeed");
+    emit_control_sites();
+    MiniLogger::CallSiteRegistry::reset();
+
+    tf.assert_equals(std::string("ok\n"), control_request("test_control.sock", "flush"),
+                     "Flush command should succeed");
+    std::string backtrace = control_request("test_control.sock", "dump-backtrace");
+    tf.assert_true(backtrace.find("Before control") != std::string::npos &&
+                   backtrace.find("Control site debug") != std::string::npos &&
+                   backtrace.find("Hidden by level") == std::string::npos,
+                   "Backtrace should dump the ring");
+    tf.assert_true(control_request("test_control.sock", "bogus").find("error:") == 0 &&
+                   control_request("test_control.sock", "set-level LOUD").find("error:") == 0,
+                   "Bad commands should be rejected");
+    struct stat st;
+    tf.assert_true(stat("test_control.sock", &st) == 0 && (st.st_mode & 0777) == 0600,
+                   "The control socket should be private to its owner");
+    bool threw = false;
+    try {
+        MiniLogger::ControlServer twice("test_control.sock", ring);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    tf.assert_true(threw && control_request("test_control.sock", "flush") == "ok\n",
+                   "A live control socket should not be replaced");
+
+    std::ofstream("test_control.txt") << "keep";
+    threw = false;
+    try {
+        MiniLogger::ControlServer wrong("test_control.txt", ring);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    tf.assert_true(threw && LoggerTestHelper::contains_pattern(
+                                LoggerTestHelper::read_file("test_control.txt"), "keep"),
+                   "A file that is not a socket should be left alone");
+    std::remove("test_control.txt");
+}
+
+void write_config(const std::string& text) {
+    std::ofstream("test_config.conf.tmp") << text;
+    std::rename("test_config.conf.tmp", "test_config.conf");
+}
+
+void test_config_reload(TestFramework& tf) {
+    write_config("# test config\n"
+                 "file = test_config.log\n"
+                 "level = warn\n"
+                 "async = true\n"
+                 "queue_size = 4\n"
+                 "overflow = drop\n");
+    setenv("SLOG_QUEUE_SIZE", "8", 1);
+    MiniLogger::LoggerManager::configure("test_config.conf");
+    unsetenv("SLOG_QUEUE_SIZE");
+
+    auto stats = MiniLogger::LoggerManager::get().stats();
+    tf.assert_true(stats.level == MiniLogger::LogLevel::WARN, "Level should come from the file");
+    tf.assert_true(stats.capacity == 8, "Environment should override the file");
+    SLOG_INFO("Config info hidden");
+    SLOG_WARN("Config warn shown");
+
+    write_config("level = DEBUG\nqueue_size = 16\nsink = compressed:test_config.slz\n");
+    bool reloaded = false;
+    for (int i = 0; i < 300 && !reloaded; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        reloaded = MiniLogger::LoggerManager::get().level() == MiniLogger::LogLevel::DEBUG;
+    }
+    tf.assert_true(reloaded, "Changing the file should reload the level");
+    stats = MiniLogger::LoggerManager::get().stats();
+    tf.assert_true(stats.capacity == 16 && stats.sinks == 1,
+                   "Queue size and sinks should be reloaded");
+    SLOG_DEBUG("Config debug shown");
+    MiniLogger::LoggerManager::get().flush();
+
+    std::string content = LoggerTestHelper::read_file("test_config.log");
+    tf.assert_true(!LoggerTestHelper::contains_pattern(content, "Config info hidden") &&
+                   LoggerTestHelper::contains_pattern(content, "Config warn shown") &&
+                   LoggerTestHelper::contains_pattern(content, "Config debug shown"),
+                   "The log file should follow the configured levels");
+
+    std::ofstream("test_config.conf.bad") << "level = LOUD\n";
+    bool rejected = false;
+    try {
+        MiniLogger::LoggerSettings settings;
+        settings.load_file("test_config.conf.bad");
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    std::remove("test_config.conf.bad");
+    tf.assert_true(rejected, "Invalid settings should be rejected");
+    MiniLogger::LoggerManager::shutdown();
+
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto slow = std::make_shared<SlowSink>(std::chrono::milliseconds(5));
+    logger.add_sink(slow);
+    logger.set_queue_capacity(2, MiniLogger::OverflowPolicy::DROP);
+    for (int i = 0; i < 20; ++i) {
+        logger.info("Overflow {}", i);
+    }
+    logger.flush();
+    auto dropped = logger.stats().dropped;
+    tf.assert_true(dropped > 0 && slow->written + dropped == 20,
+                   "A full queue should drop and count records");
+}
+
+class GateSink : public MiniLogger::Sink {
+public:
+    void write(const MiniLogger::LogRecord& record) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!entered_) {
+            entered_ = true;
+            cv_.notify_all();
+            cv_.wait(lock, [this] { return open_; });
+        }
+        records.push_back(record);
+    }
+    void wait_entered() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return entered_; });
+    }
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        cv_.notify_all();
+    }
+    std::vector<MiniLogger::LogRecord> records;
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool entered_ = false;
+    bool open_ = false;
+};
+
+// Sink writing one record per step(), to hold a steady backlog
+class StepSink : public MiniLogger::Sink {
+public:
+    void write(const MiniLogger::LogRecord& record) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return permits_ > 0; });
+        permits_--;
+        records.push_back(record);
+        cv_.notify_all();
+    }
+    void step() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_t target = records.size() + 1;
+        permits_++;
+        cv_.notify_all();
+        cv_.wait(lock, [this, target] { return records.size() >= target; });
+    }
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        permits_ = 1 << 30;
+        cv_.notify_all();
+    }
+    std::vector<MiniLogger::LogRecord> records;
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int permits_ = 0;
+};
+
+void test_control_flush_timeout(TestFramework& tf) {
+    // A stalled sink makes the flush command time out instead of hanging
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto gate = std::make_shared<GateSink>();
+    logger.add_sink(gate);
+    MiniLogger::ControlServer server("test_control.sock", nullptr, &logger,
+                                     std::chrono::milliseconds(50));
+    logger.info("Stall");
+    gate->wait_entered();
+    tf.assert_equals(std::string("error: timeout\n"), control_request("test_control.sock", "flush"),
+                     "A flush that does not finish in time should report a timeout");
+    gate->open();
+    tf.assert_equals(std::string("ok\n"), control_request("test_control.sock", "flush"),
+                     "Flush should succeed once the sink moves again");
+}
+
+void test_load_shedding(TestFramework& tf) {
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto gate = std::make_shared<GateSink>();
+    logger.add_sink(gate);
+    logger.enable_load_shedding(10, 2, 5);
+
+    logger.info("Stall");
+    gate->wait_entered();
+    for (int i = 0; i < 10; ++i) logger.info("Fill {}", i);
+    tf.assert_true(logger.stats().effective_level == MiniLogger::LogLevel::INFO,
+                   "High watermark should drop DEBUG");
+    logger.debug("Shed debug");
+    for (int i = 0; i < 10; ++i) logger.warn("Repeated warning");
+    for (int i = 0; i < 10; ++i) logger.info("More {}", i);
+    tf.assert_true(logger.stats().effective_level == MiniLogger::LogLevel::WARN,
+                   "Twice the high watermark should drop INFO");
+    for (int i = 0; i < 3; ++i) logger.error("Important");
+
+    gate->open();
+    logger.flush();
+
+    auto count = [&](const std::string& text) {
+        int n = 0;
+        for (const auto& record : gate->records) {
+            if (record.entry.find(text) != std::string::npos) n++;
+        }
+        return n;
+    };
+    tf.assert_true(count("] Load shedding: ") == 2 && count("] Load shedding ended: ") == 1,
+                   "Shedding changes should be logged");
+    tf.assert_true(count("Shed debug") == 0 && count("More 9") == 0,
+                   "Records below the raised level should be shed");
+    tf.assert_true(count("Repeated warning") == 2, "Repeated messages should be sampled");
+    tf.assert_true(count("Important") == 3, "Errors should survive shedding");
+    auto stats = logger.stats();
+    tf.assert_true(stats.shed == 1 + 8 + 3, "Shed records should be counted");
+    tf.assert_true(stats.effective_level == MiniLogger::LogLevel::DEBUG,
+                   "The level should be restored once the queue drains");
+}
+
+void test_spill(TestFramework& tf) {
+    {
+        MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+        auto gate = std::make_shared<GateSink>();
+        logger.add_sink(gate);
+        logger.set_queue_capacity(2, MiniLogger::OverflowPolicy::SPILL);
+        logger.enable_spill("test_spill.bin", 64 * 1024);
+
+        logger.info("Stall");
+        gate->wait_entered();
+        {
+            SLOG_CONTEXT("request_id", "r1");
+            SLOG_CONTEXT("user", 7);
+            for (int i = 0; i < 30; ++i) logger.info("Spill {}", i);
+        }
+        auto stats = logger.stats();
+        tf.assert_true(stats.queued == 2 && stats.spilled == 28,
+                       "Records beyond the capacity should go to the spill file");
+
+        gate->open();
+        logger.flush();
+        bool ordered = gate->records.size() == 31;
+        for (int i = 0; ordered && i < 30; ++i) {
+            ordered = gate->records[i + 1].entry.find("] Spill " + std::to_string(i)) !=
+                      std::string::npos;
+        }
+        tf.assert_true(ordered, "Spilled records should be written in order");
+        const auto& context = gate->records.back().context;
+        tf.assert_true(context && context->key == "user" && context->value == "7" &&
+                       context->parent && context->parent->key == "request_id" &&
+                       gate->records.back().entry.find("[request_id=r1 user=7] Spill 29") !=
+                           std::string::npos,
+                       "Spilled records should keep their context fields");
+        stats = logger.stats();
+        tf.assert_true(stats.spilled == 0 && stats.dropped == 0,
+                       "No record should be lost");
+    }
+    tf.assert_true(!std::ifstream("test_spill.bin").is_open(),
+                   "The spill file should be removed with the logger");
+
+    // A small steady backlog must not fill the file however much goes through
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto step = std::make_shared<StepSink>();
+    logger.add_sink(step);
+    logger.set_queue_capacity(2, MiniLogger::OverflowPolicy::SPILL);
+    logger.enable_spill("test_spill.bin", 2048);
+    for (int i = 0; i < 10; ++i) logger.info("Steady {}", i);
+    for (int i = 10; i < 300; ++i) {
+        logger.info("Steady {}", i);
+        step->step();
+    }
+    step->open();
+    logger.flush();
+    bool ordered = step->records.size() == 300;
+    for (int i = 0; ordered && i < 300; ++i) {
+        ordered = step->records[i].entry.find("] Steady " + std::to_string(i)) !=
+                  std::string::npos;
+    }
+    tf.assert_true(ordered && logger.stats().dropped == 0,
+                   "The spill file should be reused as a ring");
+    // Producers spilling concurrently keep their own order
+    MiniLogger::Logger shared("", MiniLogger::LogLevel::DEBUG, true);
+    auto collect = std::make_shared<CollectSink>();
+    shared.add_sink(collect);
+    shared.set_queue_capacity(2, MiniLogger::OverflowPolicy::SPILL);
+    shared.enable_spill("test_spill2.bin", 1024 * 1024);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&shared, t]() {
+            for (int i = 0; i < 500; ++i) shared.info("Producer {} record {}", t, i);
+        });
+    }
+    for (auto& producer : producers) producer.join();
+    shared.flush();
+    int next[4] = {0, 0, 0, 0};
+    ordered = shared.stats().dropped == 0;
+    for (auto& record : collect->records) {
+        int t, i;
+        if (ordered && std::sscanf(record.message.c_str(), "Producer %d record %d", &t, &i) == 2) {
+            ordered = i == next[t]++;
+        }
+    }
+    tf.assert_true(ordered && collect->records.size() == 2000,
+                   "Concurrent producers should not lose or reorder records");
+}
+
+void test_priority_lane(TestFramework& tf) {
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto gate = std::make_shared<GateSink>();
+    logger.add_sink(gate);
+    logger.enable_priority_lane(MiniLogger::LogLevel::ERROR, true);
+
+    logger.info("Stall");
+    gate->wait_entered();
+    for (int i = 0; i < 5; ++i) logger.debug("Backlog {}", i);
+    logger.error("Urgent");
+    gate->open();
+    logger.flush();
+    tf.assert_true(gate->records.size() == 7 &&
+                   gate->records[1].entry.find("[order=early] Urgent") != std::string::npos,
+                   "Errors should overtake queued records and be marked");
+    tf.assert_true(gate->records[2].entry.find("Backlog 0") != std::string::npos &&
+                   gate->records[6].entry.find("Backlog 4") != std::string::npos,
+                   "The normal queue should keep its order");
+
+    logger.critical("Fatal");
+    tf.assert_true(gate->records.size() == 8 &&
+                   gate->records[7].entry.find("Fatal") != std::string::npos,
+                   "CRITICAL should be written by the logging thread");
+}
+
+void test_sink_workers(TestFramework& tf) {
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+    auto gate = std::make_shared<GateSink>();
+    auto ring = std::make_shared<MiniLogger::RingSink>(64, 128);
+    logger.add_sink(gate);
+    logger.enable_sink_workers(2);
+    logger.add_sink(ring);
+
+    logger.info("Stall");
+    gate->wait_entered();
+    for (int i = 0; i < 20; ++i) logger.info("Parallel {}", i);
+    for (int i = 0; i < 200 && ring->total() < 21; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    tf.assert_true(ring->total() == 21, "A stalled sink should not hold back the others");
+    tf.assert_true(!logger.flush(std::chrono::milliseconds(20)),
+                   "flush() should wait for every sink worker");
+
+    gate->open();
+    tf.assert_true(logger.flush(), "flush() should succeed once the sink recovers");
+    tf.assert_true(gate->records.size() == 21 &&
+                   gate->records.back().entry.find("Parallel 19") != std::string::npos,
+                   "The stalled sink should get every record in order");
+
+    // A stalled sink fills only its own bounded queue, and does not hold up
+    // replacing sinks
+    MiniLogger::Logger bounded("", MiniLogger::LogLevel::DEBUG, true);
+    auto stalled = std::make_shared<GateSink>();
+    auto other = std::make_shared<MiniLogger::RingSink>(64, 128);
+    bounded.add_sink(stalled);
+    bounded.enable_sink_workers(2, 5);
+    bounded.add_sink(other);
+    bounded.info("Stall");
+    stalled->wait_entered();
+    for (size_t i = 0; i < 20; ++i) {
+        bounded.info("Bounded {}", i);
+        while (other->total() < i + 2) std::this_thread::yield();
+    }
+    auto stats = bounded.stats();
+    auto start = std::chrono::steady_clock::now();
+    bool replaced = bounded.replace_sinks({other}, {}, std::chrono::milliseconds(50));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    stalled->open();
+    bounded.flush();
+    tf.assert_true(stats.sink_queued == 5 && stats.sink_dropped == 15,
+                   "A full sink worker queue should drop records for its sinks only");
+    tf.assert_true(!replaced && elapsed < std::chrono::seconds(1),
+                   "Replacing sinks should not wait for a stalled sink");
+    tf.assert_true(stalled->records.size() == 6, "The queued records should be written");
+}
+
+class FlakySink : public MiniLogger::Sink {
+public:
+    void write(const MiniLogger::LogRecord& record) override {
+        attempts++;
+        if (broken) throw std::runtime_error("No space left on device");
+        records.push_back(record.entry);
+    }
+    bool broken = false;
+    int attempts = 0;
+    std::vector<std::string> records;
+};
+
+void test_sink_health(TestFramework& tf) {
+    MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, false);
+    auto flaky = std::make_shared<FlakySink>();
+    flaky->set_health_policy(std::chrono::microseconds(0), false);
+    auto slow = std::make_shared<SlowSink>(std::chrono::milliseconds(5));
+    slow->set_health_policy(std::chrono::milliseconds(1), false);
+    logger.add_sink(flaky);
+    logger.add_sink(slow);
+
+    flaky->broken = true;
+    logger.info("Lost 1");
+    logger.info("Lost 2");
+    tf.assert_true(flaky->attempts == 1 && flaky->health().degraded() &&
+                   flaky->health().dropped_count() == 2,
+                   "A failing sink should be degraded and skipped");
+    tf.assert_true(slow->written == 1 && slow->health().degraded(),
+                   "A slow sink should be degraded after one slow write");
+    tf.assert_true(logger.stats().degraded == 2, "Degraded sinks should be counted");
+
+    flaky->broken = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (flaky->records.empty() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        logger.info("Back");
+    }
+    tf.assert_true(!flaky->health().degraded() && flaky->records.size() == 1 &&
+                   flaky->records[0].find("Back") != std::string::npos,
+                   "A sink should be retried after the backoff");
+
+    // A stream-backed sink recovers once its file can be written again
+    std::signal(SIGXFSZ, SIG_IGN);
+    MiniLogger::TraceEventSink trace("test_trace_health.json");
+    trace.set_health_policy(std::chrono::microseconds(0), false);
+    MiniLogger::LogRecord span;
+    span.span_name = "work";
+    trace.checked_write(span);
+    trace.checked_flush();
+    struct stat st;
+    stat("test_trace_health.json", &st);
+    struct rlimit saved, limited;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    limited = saved;
+    limited.rlim_cur = st.st_size;
+    setrlimit(RLIMIT_FSIZE, &limited);
+    trace.checked_write(span);
+    trace.checked_flush();
+    setrlimit(RLIMIT_FSIZE, &saved);
+    tf.assert_true(trace.health().degraded(), "A failed stream write should degrade the sink");
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (trace.health().degraded() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        trace.checked_write(span);
+        trace.checked_flush();
+    }
+    tf.assert_true(!trace.health().degraded(), "A stream-backed sink should recover");
+    std::remove("test_trace_health.json");
+
+    // Records lost with the buffer of a failed flush are counted
+    {
+        MiniLogger::FileSink file("test_filesink_health.log");
+        file.set_health_policy(std::chrono::microseconds(0), false);
+        MiniLogger::LogRecord record(MiniLogger::LogLevel::INFO, "Buffered");
+        for (int i = 0; i < 3; ++i) file.checked_write(record);
+        limited.rlim_cur = 0;
+        setrlimit(RLIMIT_FSIZE, &limited);
+        file.checked_flush();
+        setrlimit(RLIMIT_FSIZE, &saved);
+        tf.assert_true(file.health().degraded() && file.health().dropped_count() == 3,
+                       "Records lost to a failed flush should be counted as dropped");
+    }
+    std::remove("test_filesink_health.log");
+}
+
+void test_buffered_writes(TestFramework& tf) {
+    {
+        MiniLogger::Logger logger("test_buffered.log", MiniLogger::LogLevel::DEBUG);
+        logger.enable_time_index(512);
+        logger.enable_buffered_writes(std::chrono::seconds(10), 4096);
+        logger.info("Buffered first");
+        tf.assert_true(!LoggerTestHelper::contains_pattern(
+                           LoggerTestHelper::read_file("test_buffered.log"), "Buffered first"),
+                       "Entries should wait in the buffer");
+        logger.flush();
+        tf.assert_true(LoggerTestHelper::contains_pattern(
+                           LoggerTestHelper::read_file("test_buffered.log"), "Buffered first"),
+                       "flush() should write the buffer out");
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&logger, t] {
+                for (int i = 0; i < 100; ++i) logger.info("Buffered {} {}", t, i);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    }
+
+    std::vector<std::string> lines;
+    std::istringstream all(LoggerTestHelper::read_file("test_buffered.log"));
+    std::string line;
+    while (std::getline(all, line)) {
+        lines.push_back(line);
+    }
+    tf.assert_true(lines.size() == 401, "Every buffered entry should reach the file");
+    std::string from = lines[200].substr(0, 26);
+    tf.assert_true(MiniLogger::TimeIndex::find_offset("test_buffered.log", from) > 0,
+                   "Buffered writes should keep the time index");
+}
+
+void test_file_sink(TestFramework& tf) {
+    {
+        // Two loggers appending to one file stand in for two processes
+        MiniLogger::Logger first("", MiniLogger::LogLevel::DEBUG, true);
+        MiniLogger::Logger second("", MiniLogger::LogLevel::DEBUG, true);
+        auto a = std::make_shared<MiniLogger::FileSink>("test_filesink.log",
+                                                        MiniLogger::LogLevel::DEBUG, 512);
+        auto b = std::make_shared<MiniLogger::FileSink>("test_filesink.log",
+                                                        MiniLogger::LogLevel::DEBUG, 512);
+        a->drop_cache(4096);
+        first.add_sink(a);
+        second.add_sink(b);
+        for (int i = 0; i < 500; ++i) {
+            first.info("First writer line {}", i);
+            second.info("Second writer line {}", i);
+        }
+    }
+    std::istringstream all(LoggerTestHelper::read_file("test_filesink.log"));
+    std::string line;
+    int lines = 0, intact = 0;
+    while (std::getline(all, line)) {
+        lines++;
+        if (line.find("] First writer line ") != std::string::npos ||
+            line.find("] Second writer line ") != std::string::npos) {
+            intact++;
+        }
+    }
+    tf.assert_true(lines == 1000 && intact == 1000,
+                   "Appends from several writers should keep lines whole");
+
+    struct stat open_st, closed_st;
+    {
+        MiniLogger::Logger logger("test_prealloc.log");
+        logger.preallocate_file(4 * 1024 * 1024);
+        logger.drop_file_cache(16 * 1024);
+        for (int i = 0; i < 2000; ++i) logger.info("Preallocated line {}", i);
+        stat("test_prealloc.log", &open_st);
+    }
+    stat("test_prealloc.log", &closed_st);
+    std::string content = LoggerTestHelper::read_file("test_prealloc.log");
+    tf.assert_true(std::count(content.begin(), content.end(), '\n') == 2000 &&
+                   content.find('\0') == std::string::npos,
+                   "Preallocation should not change the file contents");
+#ifdef __linux__
+    tf.assert_true(open_st.st_blocks * 512 >= open_st.st_size + 1024 * 1024,
+                   "Space should be allocated past the end while open");
+    tf.assert_true(closed_st.st_blocks * 512 < closed_st.st_size + 1024 * 1024,
+                   "The preallocated tail should be trimmed on close");
+#endif
+}
+
+void test_console_sink(TestFramework& tf) {
+    std::cout.flush();
+    int saved = dup(STDOUT_FILENO);
+    int fd = open("test_console.out", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, STDOUT_FILENO);
+    close(fd);
+    bool auto_colored;
+    {
+        MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+        auto plain = std::make_shared<MiniLogger::ConsoleSink>();
+        auto colored = std::make_shared<MiniLogger::ConsoleSink>(
+            MiniLogger::ConsoleSink::Stream::STDOUT, MiniLogger::LogLevel::ERROR,
+            MiniLogger::ConsoleSink::Color::ALWAYS);
+        auto_colored = plain->colored();
+        logger.add_sink(plain);
+        logger.add_sink(colored);
+        logger.info("Console info");
+        logger.error("Console error");
+        logger.flush();
+    }
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    std::string content = LoggerTestHelper::read_file("test_console.out");
+    std::remove("test_console.out");
+    tf.assert_true(!auto_colored, "Color::AUTO should not color a file");
+    tf.assert_true(LoggerTestHelper::contains_pattern(content, "[INFO] [Thread:") &&
+                   LoggerTestHelper::contains_pattern(content, "\033[31m[ERROR]\033[0m [Thread:"),
+                   "Only the forced sink should color the level tag");
+    tf.assert_true(std::count(content.begin(), content.end(), '\n') == 3,
+                   "Each sink should write its own lines");
+}
+
+// Bind a datagram socket standing in for the syslog or journal daemon
+static int bind_datagram(const char* path) {
+    std::remove(path);
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, path);
+    bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    return fd;
+}
+
+static std::string receive_datagram(int fd) {
+    char buffer[4096];
+    ssize_t n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    return n > 0 ? std::string(buffer, n) : std::string();
+}
+
+void test_syslog_journal(TestFramework& tf) {
+    int syslog_fd = bind_datagram("test_syslog.sock");
+    int journal_fd = bind_datagram("test_journal.sock");
+    {
+        MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+        logger.add_sink(std::make_shared<MiniLogger::SyslogSink>("testapp", "test_syslog.sock"));
+        logger.add_sink(std::make_shared<MiniLogger::JournalSink>("testapp", "test_journal.sock"));
+        logger.warn("Plain warning");
+        {
+            SLOG_CONTEXT("request_id", "a\"b]");
+            SLOG_CONTEXT("user", "x\ny");
+            logger.error("With context");
+        }
+        logger.flush();
+    }
+
+    std::string first = receive_datagram(syslog_fd);
+    std::string second = receive_datagram(syslog_fd);
+    std::regex header("<12>1 \\d{4}-\\d\\d-\\d\\dT\\d\\d:\\d\\d:\\d\\d\\.\\d{6}Z \\S+ testapp \\d+ - - Plain warning");
+    tf.assert_true(std::regex_match(first, header), "Syslog message should follow RFC 5424");
+    tf.assert_true(LoggerTestHelper::contains_pattern(second, "<11>1 ") &&
+                   LoggerTestHelper::contains_pattern(second,
+                       " - [ctx@32473 request_id=\"a\\\"b\\]\" user=\"x\ny\"] With context"),
+                   "Context should be sent as escaped structured data");
+
+    std::string plain = receive_datagram(journal_fd);
+    std::string context = receive_datagram(journal_fd);
+    tf.assert_true(LoggerTestHelper::contains_pattern(plain,
+                       "MESSAGE=Plain warning\nPRIORITY=4\nSYSLOG_IDENTIFIER=testapp\n"),
+                   "Journal message should carry the standard fields");
+    tf.assert_true(LoggerTestHelper::contains_pattern(context, "REQUEST_ID=a\"b]\n") &&
+                   LoggerTestHelper::contains_pattern(context,
+                       std::string("USER\n\x03\0\0\0\0\0\0\0x\ny\n", 15)),
+                   "Context should be sent as journal fields");
+
+    // Records read back from the spill file keep their fields
+    {
+        MiniLogger::Logger logger("", MiniLogger::LogLevel::DEBUG, true);
+        auto gate = std::make_shared<GateSink>();
+        logger.add_sink(gate);
+        logger.add_sink(std::make_shared<MiniLogger::SyslogSink>("testapp", "test_syslog.sock"));
+        logger.add_sink(std::make_shared<MiniLogger::JournalSink>("testapp", "test_journal.sock"));
+        logger.set_queue_capacity(1, MiniLogger::OverflowPolicy::SPILL);
+        logger.enable_spill("test_spill.bin", 64 * 1024);
+        logger.info("Stall");
+        gate->wait_entered();
+        {
+            SLOG_CONTEXT("request_id", "abc");
+            logger.info("Queued");
+            logger.info("Spilled");
+        }
+        tf.assert_true(logger.stats().spilled == 1, "A record should be spilled");
+        gate->open();
+        logger.flush();
+    }
+    receive_datagram(syslog_fd);
+    receive_datagram(syslog_fd);
+    tf.assert_true(LoggerTestHelper::contains_pattern(receive_datagram(syslog_fd),
+                       " - [ctx@32473 request_id=\"abc\"] Spilled"),
+                   "Spilled records should keep their structured data");
+    receive_datagram(journal_fd);
+    receive_datagram(journal_fd);
+    std::string spilled = receive_datagram(journal_fd);
+    tf.assert_true(LoggerTestHelper::contains_pattern(spilled, "MESSAGE=Spilled\n") &&
+                   LoggerTestHelper::contains_pattern(spilled, "\nREQUEST_ID=abc\n") &&
+                   !LoggerTestHelper::contains_pattern(spilled, "CTX_"),
+                   "Spilled records should keep their journal fields");
+
+    // Entries too large for a datagram go to the journal through a memfd;
+    // syslog has no such way and counts them as dropped
+    std::string large(300 * 1024, 'x');
+    {
+        MiniLogger::SyslogSink syslog("testapp", "test_syslog.sock");
+        MiniLogger::JournalSink journal("testapp", "test_journal.sock");
+        MiniLogger::LogRecord record(MiniLogger::LogLevel::INFO, "");
+        record.message = large;
+        syslog.checked_write(record);
+        syslog.checked_flush();
+        journal.checked_write(record);
+        journal.checked_flush();
+        tf.assert_true(syslog.health().dropped_count() == 1 &&
+                       journal.health().dropped_count() == 0,
+                       "Oversized syslog messages should be counted as dropped");
+    }
+    auto receive_memfd = [&]() {
+        char data[1];
+        char control[CMSG_SPACE(sizeof(int))];
+        iovec iov = {data, sizeof(data)};
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        std::string passed;
+        if (recvmsg(journal_fd, &msg, MSG_DONTWAIT) == 0 && CMSG_FIRSTHDR(&msg) &&
+            CMSG_FIRSTHDR(&msg)->cmsg_type == SCM_RIGHTS) {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(CMSG_FIRSTHDR(&msg)), sizeof(fd));
+            char buffer[4096];
+            ssize_t n;
+            while ((n = pread(fd, buffer, sizeof(buffer), passed.size())) > 0) passed.append(buffer, n);
+            close(fd);
+        }
+        return passed;
+    };
+    std::string passed = receive_memfd();
+    tf.assert_true(passed.compare(0, 8, "MESSAGE=") == 0 &&
+                   passed.find(large + "\nPRIORITY=6\n") == 8,
+                   "Oversized journal entries should be passed as a memfd");
+    {
+        MiniLogger::JournalSink journal("testapp", "test_journal.sock");
+        MiniLogger::LogRecord record(MiniLogger::LogLevel::INFO, "");
+        record.message = large;
+        journal.checked_write(record);
+    }
+    tf.assert_true(receive_memfd().find(large + "\nPRIORITY=6\n") == 8,
+                   "Oversized journal entries pending at destruction should use the memfd");
+
+    // Records lost to a failed send are counted
+    {
+        MiniLogger::SyslogSink syslog("testapp", "test_syslog.sock");
+        close(syslog_fd);
+        syslog_fd = -1;
+        MiniLogger::LogRecord record(MiniLogger::LogLevel::INFO, "");
+        record.message = "Nobody listening";
+        syslog.checked_write(record);
+        syslog.checked_write(record);
+        syslog.checked_flush();
+        tf.assert_true(syslog.health().degraded() && syslog.health().dropped_count() == 2,
+                       "Records lost to a failed send should be counted as dropped");
+    }
+
+    close(journal_fd);
+    std::remove("test_syslog.sock");
+    std::remove("test_journal.sock");
+
+    bool threw = false;
+    try {
+        MiniLogger::SyslogSink missing("testapp", "test_missing.sock");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    tf.assert_true(threw, "A missing socket should throw");
+}
+
 int main() {
     std::cout << "Running Simple Logger Unit Tests (C++14)\n" << std::string(50, '=') << std::endl;
     
@@ -357,6 +1699,31 @@ int main() {
     tf.run_test("Direct Logger Access", [&]() { test_direct_logger_access(tf); });
     tf.run_test("Level Change", [&]() { test_level_change(tf); });
     tf.run_test("Error Handling", [&]() { test_error_handling(tf); });
+    tf.run_test("Flight Recorder Sink", [&]() { test_flight_recorder(tf); });
+    tf.run_test("Time Index", [&]() { test_time_index(tf); });
+    tf.run_test("Compressed Sink", [&]() { test_compressed_sink(tf); });
+    tf.run_test("Rotation and Retention", [&]() { test_rotation_and_retention(tf); });
+    tf.run_test("Reopen", [&]() { test_reopen(tf); });
+    tf.run_test("Durable Mode", [&]() { test_durable_mode(tf); });
+    tf.run_test("Flush Barrier", [&]() { test_flush_barrier(tf); });
+    tf.run_test("Ring Sink", [&]() { test_ring_sink(tf); });
+    tf.run_test("Trace Spans", [&]() { test_trace_spans(tf); });
+    tf.run_test("Mapped Diagnostic Context", [&]() { test_context(tf); });
+    tf.run_test("Call Site Control", [&]() { test_call_sites(tf); });
+    tf.run_test("Control Server", [&]() {
+        test_control_server(tf);
+        test_control_flush_timeout(tf);
+    });
+    tf.run_test("Config and Reload", [&]() { test_config_reload(tf); });
+    tf.run_test("Load Shedding", [&]() { test_load_shedding(tf); });
+    tf.run_test("Spill File", [&]() { test_spill(tf); });
+    tf.run_test("Priority Lane", [&]() { test_priority_lane(tf); });
+    tf.run_test("Sink Workers", [&]() { test_sink_workers(tf); });
+    tf.run_test("Sink Health", [&]() { test_sink_health(tf); });
+    tf.run_test("Buffered Writes", [&]() { test_buffered_writes(tf); });
+    tf.run_test("File Sink", [&]() { test_file_sink(tf); });
+    tf.run_test("Console Sink", [&]() { test_console_sink(tf); });
+    tf.run_test("Syslog and Journal Sinks", [&]() { test_syslog_journal(tf); });
     
     // Print summary
     tf.print_summary();
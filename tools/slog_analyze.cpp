@@ -0,0 +1,397 @@
+/**
+ * slog_analyze - Parallel summary of minispdlog log files
+ *
+ * Maps log files written in the Logger::format_log_entry layout
+ *
+ *     YYYY-MM-DD HH:MM:SS.uuuuuu [LEVEL] [Thread:N] [context] message
+ *
+ * splits them into chunks processed by a pool of threads, and reports counts
+ * by level, thread and time bucket, plus the most frequent messages once
+ * their arguments (numbers, hex values, quoted strings) have been stripped.
+ * Line boundaries are found with SSE2/AVX2 when available.
+ *
+ * Usage: slog_analyze [-j threads] [-n top] [-b second|minute|hour] file...
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SLOG_HAVE_AVX2_DISPATCH
+#endif
+
+namespace {
+
+const size_t TIMESTAMP_WIDTH = 26; // "YYYY-MM-DD HH:MM:SS.uuuuuu"
+const char *LEVELS[] = {"DEBUG", "INFO", "WARN", "ERROR", "CRITICAL"};
+const size_t LEVEL_COUNT = 5;
+
+// Newline scanning ----------------------------------------------------------
+
+const char *find_newline_scalar(const char *p, const char *end) {
+    const void *hit = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return hit ? static_cast<const char *>(hit) : end;
+}
+
+#if defined(__SSE2__)
+const char *find_newline_sse2(const char *p, const char *end) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+        if (mask != 0) {
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+    return find_newline_scalar(p, end);
+}
+#endif
+
+#if defined(SLOG_HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2"))) const char *
+find_newline_avx2(const char *p, const char *end) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i chunk =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return find_newline_scalar(p, end);
+}
+#endif
+
+typedef const char *(*FindNewline)(const char *, const char *);
+
+FindNewline select_find_newline() {
+#if defined(SLOG_HAVE_AVX2_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return find_newline_avx2;
+    }
+#endif
+#if defined(__SSE2__)
+    return find_newline_sse2;
+#else
+    return find_newline_scalar;
+#endif
+}
+
+// Per-chunk statistics ------------------------------------------------------
+
+struct Stats {
+    uint64_t lines = 0;
+    uint64_t unparsed = 0;
+    uint64_t levels[LEVEL_COUNT] = {0, 0, 0, 0, 0};
+    std::unordered_map<std::string, uint64_t> threads;
+    std::unordered_map<std::string, uint64_t> buckets;
+    std::unordered_map<std::string, uint64_t> messages;
+
+    void merge(const Stats &other) {
+        lines += other.lines;
+        unparsed += other.unparsed;
+        for (size_t i = 0; i < LEVEL_COUNT; ++i) {
+            levels[i] += other.levels[i];
+        }
+        for (const auto &kv : other.threads) threads[kv.first] += kv.second;
+        for (const auto &kv : other.buckets) buckets[kv.first] += kv.second;
+        for (const auto &kv : other.messages) messages[kv.first] += kv.second;
+    }
+};
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+inline bool is_hex(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * Replace the variable parts of a message with "{}"
+ * Numbers (including decimals and 0x... values) and quoted strings are
+ * considered arguments, so messages coming from the same format string end
+ * up with the same key.
+ */
+std::string strip_arguments(const char *p, const char *end) {
+    std::string out;
+    out.reserve(static_cast<size_t>(end - p));
+    while (p < end) {
+        char c = *p;
+        if (c == '"' || c == '\'') {
+            const char *close =
+                static_cast<const char *>(std::memchr(p + 1, c, end - p - 1));
+            if (close) {
+                out += "{}";
+                p = close + 1;
+                continue;
+            }
+        }
+        bool word_start = out.empty() || !std::isalnum(
+                                              static_cast<unsigned char>(out.back()));
+        if (is_digit(c) && word_start) {
+            if (c == '0' && p + 1 < end && (p[1] == 'x' || p[1] == 'X')) {
+                p += 2;
+                while (p < end && is_hex(*p)) ++p;
+            } else {
+                while (p < end && (is_digit(*p) || *p == '.')) ++p;
+            }
+            out += "{}";
+            continue;
+        }
+        out += c;
+        ++p;
+    }
+    return out;
+}
+
+/**
+ * Parse a single line (without its newline) into the statistics
+ */
+void account_line(Stats &stats, const char *p, const char *end,
+                  size_t bucket_width) {
+    if (p == end) {
+        return;
+    }
+    stats.lines++;
+    // Timestamp, then " [LEVEL] [Thread:N] "
+    if (static_cast<size_t>(end - p) < TIMESTAMP_WIDTH + 3 ||
+        p[TIMESTAMP_WIDTH] != ' ' || p[TIMESTAMP_WIDTH + 1] != '[' ||
+        !is_digit(p[0])) {
+        stats.unparsed++;
+        return;
+    }
+    const char *level = p + TIMESTAMP_WIDTH + 2;
+    const char *level_end =
+        static_cast<const char *>(std::memchr(level, ']', end - level));
+    if (!level_end) {
+        stats.unparsed++;
+        return;
+    }
+    size_t level_len = static_cast<size_t>(level_end - level);
+    for (size_t i = 0; i < LEVEL_COUNT; ++i) {
+        if (std::strlen(LEVELS[i]) == level_len &&
+            std::memcmp(LEVELS[i], level, level_len) == 0) {
+            stats.levels[i]++;
+            break;
+        }
+    }
+    stats.buckets[std::string(p, bucket_width)]++;
+
+    const char *msg = level_end + 1;
+    static const char THREAD_TAG[] = " [Thread:";
+    const size_t tag_len = sizeof(THREAD_TAG) - 1;
+    if (static_cast<size_t>(end - msg) > tag_len &&
+        std::memcmp(msg, THREAD_TAG, tag_len) == 0) {
+        const char *tid = msg + tag_len;
+        const char *tid_end =
+            static_cast<const char *>(std::memchr(tid, ']', end - tid));
+        if (tid_end) {
+            stats.threads[std::string(tid, tid_end)]++;
+            msg = tid_end + 1;
+        }
+    }
+    // The context block, " [key=value ...]", is not part of the message
+    if (end - msg > 2 && msg[0] == ' ' && msg[1] == '[') {
+        const char *ctx_end =
+            static_cast<const char *>(std::memchr(msg, ']', end - msg));
+        if (ctx_end && std::memchr(msg, '=', ctx_end - msg)) {
+            msg = ctx_end + 1;
+        }
+    }
+    if (msg < end && *msg == ' ') {
+        ++msg;
+    }
+    stats.messages[strip_arguments(msg, end)]++;
+}
+
+void analyze_chunk(const char *begin, const char *end, size_t bucket_width,
+                   FindNewline find_newline, Stats *stats) {
+    const char *p = begin;
+    while (p < end) {
+        const char *nl = find_newline(p, end);
+        account_line(*stats, p, nl, bucket_width);
+        p = nl + 1;
+    }
+}
+
+/**
+ * Split [data, data + size) into at most `parts` chunks ending on newlines
+ */
+std::vector<std::pair<const char *, const char *>>
+split_chunks(const char *data, size_t size, size_t parts) {
+    std::vector<std::pair<const char *, const char *>> chunks;
+    const char *end = data + size;
+    const char *p = data;
+    size_t step = std::max<size_t>(size / parts, 1);
+    while (p < end) {
+        const char *cut = p + std::min(step, static_cast<size_t>(end - p));
+        if (cut < end) {
+            const void *nl = std::memchr(cut, '\n', end - cut);
+            cut = nl ? static_cast<const char *>(nl) + 1 : end;
+        }
+        chunks.emplace_back(p, cut);
+        p = cut;
+    }
+    return chunks;
+}
+
+bool analyze_file(const std::string &path, size_t jobs, size_t bucket_width,
+                  FindNewline find_newline, Stats &total) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "slog_analyze: cannot open " << path << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        std::cerr << "slog_analyze: cannot stat " << path << std::endl;
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return true;
+    }
+    void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "slog_analyze: cannot map " << path << std::endl;
+        return false;
+    }
+    ::madvise(map, size, MADV_SEQUENTIAL);
+
+    auto chunks = split_chunks(static_cast<const char *>(map), size, jobs);
+    std::vector<Stats> results(chunks.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        workers.emplace_back(analyze_chunk, chunks[i].first, chunks[i].second,
+                             bucket_width, find_newline, &results[i]);
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    for (const auto &r : results) {
+        total.merge(r);
+    }
+    ::munmap(map, size);
+    return true;
+}
+
+template <typename Map>
+std::vector<std::pair<std::string, uint64_t>> top_n(const Map &map, size_t n) {
+    std::vector<std::pair<std::string, uint64_t>> items(map.begin(), map.end());
+    auto by_count = [](const std::pair<std::string, uint64_t> &a,
+                       const std::pair<std::string, uint64_t> &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    };
+    if (items.size() > n) {
+        std::partial_sort(items.begin(), items.begin() + n, items.end(),
+                          by_count);
+        items.resize(n);
+    } else {
+        std::sort(items.begin(), items.end(), by_count);
+    }
+    return items;
+}
+
+void print_report(const Stats &stats, size_t top) {
+    std::cout << "Lines: " << stats.lines << " (unparsed: " << stats.unparsed
+              << ")\n\nBy level:\n";
+    for (size_t i = 0; i < LEVEL_COUNT; ++i) {
+        std::cout << std::setw(12) << stats.levels[i] << "  " << LEVELS[i]
+                  << "\n";
+    }
+    std::cout << "\nBy thread (top " << top << "):\n";
+    for (const auto &kv : top_n(stats.threads, top)) {
+        std::cout << std::setw(12) << kv.second << "  " << kv.first << "\n";
+    }
+    std::cout << "\nBy time:\n";
+    std::map<std::string, uint64_t> buckets(stats.buckets.begin(),
+                                            stats.buckets.end());
+    for (const auto &kv : buckets) {
+        std::cout << std::setw(12) << kv.second << "  " << kv.first << "\n";
+    }
+    std::cout << "\nTop " << top << " messages:\n";
+    for (const auto &kv : top_n(stats.messages, top)) {
+        std::cout << std::setw(12) << kv.second << "  " << kv.first << "\n";
+    }
+}
+
+void usage(const char *prog) {
+    std::cerr << "Usage: " << prog
+              << " [-j threads] [-n top] [-b second|minute|hour] file..."
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    size_t top = 10;
+    size_t bucket_width = 16; // "YYYY-MM-DD HH:MM"
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "-j" || arg == "-n" || arg == "-b") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "-j") {
+                jobs = std::max(1L, std::strtol(value.c_str(), nullptr, 10));
+            } else if (arg == "-n") {
+                top = std::max(1L, std::strtol(value.c_str(), nullptr, 10));
+            } else if (value == "second") {
+                bucket_width = 19;
+            } else if (value == "minute") {
+                bucket_width = 16;
+            } else if (value == "hour") {
+                bucket_width = 13;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FindNewline find_newline = select_find_newline();
+    Stats total;
+    bool ok = true;
+    for (const auto &file : files) {
+        ok = analyze_file(file, jobs, bucket_width, find_newline, total) && ok;
+    }
+    print_report(total, top);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+/**
+ * slog_flightdump - Decode a minispdlog flight recorder file
+ *
+ * Prints the records kept in the ring of a FlightRecorderSink file, from the
+ * oldest to the newest one. It works on files left behind by a crashed or
+ * killed process.
+ *
+ * Usage: slog_flightdump <recorder-file>
+ */
+
+#include "../minispdlog.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <recorder-file>" << std::endl;
+        return 2;
+    }
+    try {
+        std::cout << MiniLogger::FlightRecorderSink::decode(argv[1]);
+    } catch (const std::exception &e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
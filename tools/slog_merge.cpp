@@ -0,0 +1,300 @@
+/**
+ * slog_merge - Merge minispdlog log files into one chronological stream
+ *
+ * Streams any number of log files (per process, per thread, or a rotated
+ * set) through large read-ahead buffers and merges them with a heap keyed on
+ * the fixed-width timestamp prefix written by Logger::get_timestamp:
+ *
+ *     YYYY-MM-DD HH:MM:SS.uuuuuu
+ *
+ * Only that prefix is parsed; since it is fixed width and zero padded, a
+ * plain byte comparison orders it. Lines without a timestamp (multi-line
+ * messages) stay attached to the record before them. Memory usage is bounded
+ * by the buffers, whatever the size of the inputs.
+ *
+ * Usage: slog_merge [-o output] file...
+ *
+ * Exits with status 1, after a message, if an input cannot be read or the
+ * output cannot be written, synced or closed.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t TIMESTAMP_WIDTH = 26;
+const size_t READ_BUFFER_SIZE = 4 * 1024 * 1024;
+const size_t WRITE_BUFFER_SIZE = 8 * 1024 * 1024;
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * Check for the "YYYY-MM-DD HH:MM:SS.uuuuuu" prefix
+ */
+bool has_timestamp(const std::string &line) {
+    static const char PATTERN[] = "dddd-dd-dd dd:dd:dd.dddddd";
+    if (line.size() < TIMESTAMP_WIDTH) {
+        return false;
+    }
+    for (size_t i = 0; i < TIMESTAMP_WIDTH; ++i) {
+        if (PATTERN[i] == 'd' ? !is_digit(line[i]) : line[i] != PATTERN[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Sequential reader returning one record (a timestamped line plus its
+ * continuation lines) at a time
+ */
+class RecordReader {
+  public:
+    RecordReader(const std::string &path, size_t index)
+        : path_(path), index_(index),
+          fd_(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+          buffer_(READ_BUFFER_SIZE), pos_(0), len_(0), eof_(false),
+          has_pending_(false) {
+        if (fd_ < 0) {
+            throw std::runtime_error("cannot open " + path + ": " +
+                                     std::strerror(errno));
+        }
+#ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        try {
+            has_pending_ = read_line(pending_);
+        } catch (...) {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    ~RecordReader() { ::close(fd_); }
+
+    RecordReader(const RecordReader &) = delete;
+    RecordReader &operator=(const RecordReader &) = delete;
+
+    /**
+     * Load the next record into record(); false at end of input
+     */
+    bool advance() {
+        if (!has_pending_) {
+            return false;
+        }
+        record_.swap(pending_);
+        while ((has_pending_ = read_line(pending_))) {
+            if (has_timestamp(pending_)) {
+                break;
+            }
+            record_ += pending_;
+        }
+        return true;
+    }
+
+    const std::string &record() const { return record_; }
+    size_t index() const { return index_; }
+
+  private:
+    std::string path_;
+    size_t index_;
+    int fd_;
+    std::vector<char> buffer_;
+    size_t pos_;
+    size_t len_;
+    bool eof_;
+    std::string record_;
+    std::string pending_;
+    bool has_pending_;
+
+    /**
+     * Refill the buffer; false at end of file, throws on a read error
+     */
+    bool fill() {
+        if (eof_) {
+            return false;
+        }
+        ssize_t n;
+        do {
+            n = ::read(fd_, buffer_.data(), buffer_.size());
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            throw std::runtime_error("cannot read " + path_ + ": " +
+                                     std::strerror(errno));
+        }
+        if (n == 0) {
+            eof_ = true;
+            return false;
+        }
+        pos_ = 0;
+        len_ = static_cast<size_t>(n);
+        return true;
+    }
+
+    /**
+     * Read one line, newline included (added if the file lacks it)
+     */
+    bool read_line(std::string &line) {
+        line.clear();
+        for (;;) {
+            if (pos_ == len_ && !fill()) {
+                if (line.empty()) {
+                    return false;
+                }
+                line += '\n';
+                return true;
+            }
+            const char *start = buffer_.data() + pos_;
+            const void *nl = std::memchr(start, '\n', len_ - pos_);
+            if (nl) {
+                size_t n = static_cast<const char *>(nl) - start + 1;
+                line.append(start, n);
+                pos_ += n;
+                return true;
+            }
+            line.append(start, len_ - pos_);
+            pos_ = len_;
+        }
+    }
+};
+
+/**
+ * Heap ordering: earliest timestamp first, ties broken by input order
+ */
+struct LaterRecord {
+    bool operator()(const RecordReader *a, const RecordReader *b) const {
+        int cmp = std::memcmp(a->record().data(), b->record().data(),
+                              std::min(TIMESTAMP_WIDTH,
+                                       std::min(a->record().size(),
+                                                b->record().size())));
+        return cmp != 0 ? cmp > 0 : a->index() > b->index();
+    }
+};
+
+class BufferedWriter {
+  public:
+    explicit BufferedWriter(int fd) : fd_(fd) {
+        buffer_.reserve(WRITE_BUFFER_SIZE);
+    }
+
+    void write(const std::string &data) {
+        if (buffer_.size() + data.size() > WRITE_BUFFER_SIZE) {
+            flush();
+        }
+        buffer_ += data;
+    }
+
+    void flush() {
+        size_t done = 0;
+        while (done < buffer_.size()) {
+            ssize_t n = ::write(fd_, buffer_.data() + done, buffer_.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("write failed: ") +
+                                         std::strerror(errno));
+            }
+            done += static_cast<size_t>(n);
+        }
+        buffer_.clear();
+    }
+
+  private:
+    int fd_;
+    std::string buffer_;
+};
+
+void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [-o output] file..." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::string output;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int out_fd = STDOUT_FILENO;
+    if (!output.empty()) {
+        out_fd = ::open(output.c_str(),
+                        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out_fd < 0) {
+            std::cerr << argv[0] << ": cannot open " << output << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        std::vector<std::unique_ptr<RecordReader>> readers;
+        std::priority_queue<RecordReader *, std::vector<RecordReader *>,
+                            LaterRecord>
+            heap;
+        for (size_t i = 0; i < files.size(); ++i) {
+            readers.emplace_back(new RecordReader(files[i], i));
+            if (readers.back()->advance()) {
+                heap.push(readers.back().get());
+            }
+        }
+
+        BufferedWriter writer(out_fd);
+        while (!heap.empty()) {
+            RecordReader *reader = heap.top();
+            heap.pop();
+            writer.write(reader->record());
+            if (reader->advance()) {
+                heap.push(reader);
+            }
+        }
+        writer.flush();
+    } catch (const std::exception &e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        if (out_fd != STDOUT_FILENO) {
+            ::close(out_fd);
+        }
+        return 1;
+    }
+
+    if (out_fd != STDOUT_FILENO) {
+        // Errors of delayed writeback only show up here. EINVAL: not a file
+        // that can be synced, e.g. -o /dev/stdout on a terminal.
+        if (::fsync(out_fd) != 0 && errno != EINVAL) {
+            std::cerr << argv[0] << ": cannot sync " << output << ": "
+                      << std::strerror(errno) << std::endl;
+            ::close(out_fd);
+            return 1;
+        }
+        if (::close(out_fd) != 0) {
+            std::cerr << argv[0] << ": cannot close " << output << ": "
+                      << std::strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
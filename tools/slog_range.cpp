@@ -0,0 +1,29 @@
+/**
+ * slog_range - Print the records of a log file within a time range
+ *
+ * Uses the sidecar index written by Logger::enable_time_index to seek close
+ * to the start of the range, then streams records until the end of it. Bounds
+ * can be any prefix of the timestamp format, e.g. "2025-05-23 14:03". Without
+ * an index the file is scanned from the beginning.
+ *
+ * Usage: slog_range <log-file> <from> [<to>]
+ */
+
+#include "../minispdlog.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <log-file> <from> [<to>]"
+                  << std::endl;
+        return 2;
+    }
+    try {
+        std::ios::sync_with_stdio(false);
+        MiniLogger::TimeIndex::read_range(argv[1], argv[2],
+                                          argc == 4 ? argv[3] : "", std::cout);
+    } catch (const std::exception &e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+/**
+ * slog_unz - Decompress a file written by CompressedFileSink
+ *
+ * Usage: slog_unz <compressed-log> [<output>]
+ */
+
+#include "../minispdlog.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <compressed-log> [<output>]"
+                  << std::endl;
+        return 2;
+    }
+    try {
+        std::ifstream in(argv[1], std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error(std::string("Unable to open ") + argv[1]);
+        }
+        if (argc == 3) {
+            std::ofstream out(argv[2], std::ios::binary);
+            if (!out.is_open()) {
+                throw std::runtime_error(std::string("Unable to open ") +
+                                         argv[2]);
+            }
+            MiniLogger::CompressedFileSink::decompress(in, out);
+        } else {
+            MiniLogger::CompressedFileSink::decompress(in, std::cout);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}